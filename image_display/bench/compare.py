@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Compare two image_bench result files and flag regressions.
+
+Usage : compare.py [--threshold PCT] [--latency-floor US] [--cpu-floor US] baseline.json results.json
+
+Every scenario is compared on the median over its runs (image_bench --repeat),
+and a change only counts when the runs of the two sides don't overlap (every
+run worse than every baseline run) : one slow run is not a regression.
+A scenario regresses when, compared to the baseline (same scenario name) :
+  - fps drops by more than PCT % (maximum rate scenarios, target_fps = 0),
+  - cpu_us_per_frame grows by more than PCT % and by more than the CPU floor,
+  - the total latency grows by more than PCT % and by more than the latency
+    floor. The percentile compared is the highest one backed by enough
+    samples in every run : p99 from 1000 samples, p90 from 100, else p50
+    (a 30 fps scenario over 3 s has 90 samples : its p99 is its maximum),
+  - frames are dropped where the baseline had none.
+For the record sinks the throughput is the recorded rate (record.fps, any
+target_fps) rather than the rate frames are offered to the recorder, and the
+sink drop rate (sink drops / frames offered) may not grow by more than PCT
+percentage points.
+A codec entry (image_bench --codec) regresses when :
+  - mb_per_s_core drops by more than PCT %,
+  - the compression ratio drops by more than 0.5 % (the codec is deterministic),
+  - the round trip is not lossless.
+Exit status is 1 if any scenario or codec entry regressed.
+"""
+import argparse
+import json
+import statistics
+import sys
+
+# Samples needed in every run to compare a latency percentile (about 10 above it).
+PERCENTILE_SAMPLES = (("p99", 1000), ("p90", 100), ("p50", 0))
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    scenarios = {}
+    for s in data["scenarios"]:
+        scenarios.setdefault(s["name"], []).append(s)
+    return data, scenarios, {c["name"]: c for c in data.get("codec", [])}
+
+
+def change(base, new):
+    if base == 0:
+        return 0.0 if new == 0 else float("inf")
+    return 100.0 * (new - base) / base
+
+
+def drop_rate(s):
+    """Sink drops in % of the frames offered to the sink."""
+    return 100.0 * s["drops"]["sink"] / s["frames"] if s["frames"] else 0.0
+
+
+def median(runs, value):
+    return statistics.median(value(s) for s in runs)
+
+
+def separated(base, new, value, higher_is_worse):
+    """True if every new run is worse than every baseline run."""
+    if higher_is_worse:
+        return min(value(s) for s in new) > max(value(s) for s in base)
+    return max(value(s) for s in new) < min(value(s) for s in base)
+
+
+def latency_percentile(*runs):
+    """Highest total latency percentile with enough samples in all the runs."""
+    count = min(s["latency_us"]["total"]["count"] for r in runs for s in r)
+    for name, samples in PERCENTILE_SAMPLES:
+        if count >= samples:
+            return name
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed change in percent (default 10)")
+    parser.add_argument("--latency-floor", type=float, default=1000.0,
+                        help="latency increase always allowed, in us (default 1000)")
+    parser.add_argument("--cpu-floor", type=float, default=50.0,
+                        help="cpu_us_per_frame increase always allowed (default 50)")
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    args = parser.parse_args()
+
+    base_data, base, base_codec = load(args.baseline)
+    new_data, new, new_codec = load(args.results)
+    print("baseline : %s (%s)" % (base_data.get("label", ""), base_data.get("date", "")))
+    print("results  : %s (%s)" % (new_data.get("label", ""), new_data.get("date", "")))
+    print("%-36s %4s %10s %10s %10s %8s  %s" % ("scenario", "runs", "fps %", "cpu %", "latency %", "drops", "status"))
+
+    regressions = 0
+    for name, s in new.items():
+        b = base.get(name)
+        if b is None:
+            print("%-36s %4d %10s %10s %10s %8s  new" % (name, len(s), "-", "-", "-", "-"))
+            continue
+
+        recording = "record" in s[0] and "record" in b[0]
+        if recording:
+            rate = lambda r: r["record"]["fps"]
+        else:
+            rate = lambda r: r["fps"]
+        cpu = lambda r: r["cpu_us_per_frame"]
+        pct = latency_percentile(b, s)
+        latency = lambda r: r["latency_us"]["total"][pct]
+        fps = change(median(b, rate), median(s, rate))
+        cpu_change = change(median(b, cpu), median(s, cpu))
+        latency_change = change(median(b, latency), median(s, latency))
+        base_source = median(b, lambda r: r["drops"]["source"])
+        source = median(s, lambda r: r["drops"]["source"])
+        base_drops = median(b, lambda r: r["drops"]["source"] + r["drops"]["sink"])
+        drops = median(s, lambda r: r["drops"]["source"] + r["drops"]["sink"])
+
+        problems = []
+        if (recording or s[0]["target_fps"] == 0) and fps < -args.threshold and separated(b, s, rate, False):
+            problems.append("fps")
+        if (recording and median(s, drop_rate) - median(b, drop_rate) > args.threshold and
+                separated(b, s, drop_rate, True)):
+            problems.append("sink drops")
+        if (cpu_change > args.threshold and median(s, cpu) - median(b, cpu) > args.cpu_floor and
+                separated(b, s, cpu, True)):
+            problems.append("cpu")
+        if (latency_change > args.threshold and median(s, latency) - median(b, latency) > args.latency_floor and
+                separated(b, s, latency, True)):
+            problems.append("latency " + pct)
+        if recording:
+            # (Maximum rate recording always drops in the sink : its rate is checked above.)
+            if source > 0 and base_source == 0:
+                problems.append("drops")
+        elif drops > 0 and base_drops == 0:
+            problems.append("drops")
+        if problems:
+            regressions += 1
+
+        print("%-36s %4d %+10.1f %+10.1f %+6.1f %3s %8g  %s" %
+              (name, len(s), fps, cpu_change, latency_change, pct, drops,
+               ("REGRESSION (" + ", ".join(problems) + ")") if problems else "ok"))
+
+    for name in base:
+        if name not in new:
+            print("%-36s %4s %10s %10s %10s %8s  missing" % (name, "-", "-", "-", "-", "-"))
+
+    if new_codec or base_codec:
+        print("%-36s %4s %10s %10s %10s %8s  %s" % ("codec", "", "MB/s/c %", "ratio %", "dec %", "", "status"))
+    for name, c in new_codec.items():
+        b = base_codec.get(name)
+        if b is None:
+            print("%-36s %4s %10s %10s %10s %8s  new" % (name, "", "-", "-", "-", ""))
+            continue
+
+        speed = change(b["mb_per_s_core"], c["mb_per_s_core"])
+        ratio = change(b["ratio"], c["ratio"])
+        decode = change(b["decompress_mb_per_s"], c["decompress_mb_per_s"])
+
+        problems = []
+        if speed < -args.threshold:
+            problems.append("speed")
+        if ratio < -0.5:
+            problems.append("ratio")
+        if not c["lossless"]:
+            problems.append("lossless")
+        if problems:
+            regressions += 1
+
+        print("%-36s %4s %+10.1f %+10.1f %+10.1f %8s  %s" %
+              (name, "", speed, ratio, decode, "", ("REGRESSION (" + ", ".join(problems) + ")") if problems else "ok"))
+
+    for name in base_codec:
+        if name not in new_codec:
+            print("%-36s %4s %10s %10s %10s %8s  missing" % (name, "", "-", "-", "-", ""))
+
+    print("%d regression(s) over %d%% threshold" % (regressions, args.threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
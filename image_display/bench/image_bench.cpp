@@ -0,0 +1,1591 @@
+//-----------------------------------------------------------------------------
+// image_bench.cpp
+//
+// Description:
+//       End-to-end benchmark of the acquisition pipeline, built without the
+//       GigE-V SDK (stub headers + synthetic camera).
+//
+//       Every scenario (resolution x pixel format x fps x sink) streams from
+//       the synthetic camera through image_display's receive loop
+//       (frame_pipeline) while the main thread serves "stats" commands from
+//       the control queue. Every scenario runs --repeat times, one pass over
+//       the matrix per run.
+//       Results are written as JSON (one entry per run) so runs from
+//       different commits can be compared (see compare.py : medians over the
+//       runs).
+//
+//       Sinks :
+//         none    : receive only.
+//         convert : stand-in for the display conversion (Bayer -> RGB32, Mono16 -> Mono8,
+//                   Mono8 copy). image_display uses ConvertGevImageToX11Format() from the
+//                   SDK common code, which is not part of this build, so changes to the
+//                   real conversion or to Display_Image() do not show here.
+//         record  : frame_recorder to a raw file.
+//         record_codec : frame_recorder with lossless compression (frame_codec).
+//
+//       --codec measures the compression stage on its own : ratio, MB/s per
+//       core and decompression speed for each thread count, and the rate
+//       frame_recorder sustains to disk compressed vs uncompressed. Frames are
+//       synthetic, or read from a recording (--codec-input).
+//
+//       --selftest checks the codec and the recording format instead (round
+//       trips on edge case geometries, read back, corrupt data).
+//-----------------------------------------------------------------------------
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "gevapi.h"
+#include "synthetic_source.h"
+#include "control_api.h"
+#include "frame_recorder.h"
+#include "frame_codec.h"
+#include "frame_pipeline.h"
+
+#define NUM_BUF 8
+#define MAX_LIST 8
+#define CMD_POLL_PERIOD_MS 10
+#define SCHEMA_VERSION 2
+#define CODEC_MAX_FRAMES 16
+
+typedef enum
+{
+	SINK_NONE = 0,
+	SINK_CONVERT,
+	SINK_RECORD,
+	SINK_RECORD_CODEC,
+	NUM_SINKS
+} BENCH_SINK;
+
+static const char *sinkName[NUM_SINKS] = {"none", "convert", "record", "record_codec"};
+
+// Progress output (stderr when the JSON goes to stdout).
+static FILE *logFp = NULL;
+
+typedef struct tagBENCH_FORMAT
+{
+	const char *name;
+	UINT32 format;
+} BENCH_FORMAT;
+
+static const BENCH_FORMAT formatList[] = {
+	{"Mono8", fmtMono8},
+	{"Mono16", fmtMono16},
+	{"BayerRG8", fMtBayerRG8},
+	{"BayerRG16", fMtBayerRG16},
+};
+
+typedef struct tagBENCH_SCENARIO
+{
+	UINT32 width;
+	UINT32 height;
+	const BENCH_FORMAT *format;
+	double fps; // 0 = maximum sustained rate.
+	BENCH_SINK sink;
+	char name[96];
+} BENCH_SCENARIO;
+
+typedef struct tagBENCH_OPTIONS
+{
+	UINT32 width[MAX_LIST];
+	UINT32 height[MAX_LIST];
+	int numRes;
+	const BENCH_FORMAT *format[MAX_LIST];
+	int numFormats;
+	double fps[MAX_LIST];
+	int numFps;
+	BENCH_SINK sink[MAX_LIST];
+	int numSinks;
+	unsigned int durationMs;
+	unsigned int warmupMs;
+	int repeat; // Runs of every scenario (compare.py compares the medians).
+	const char *outFile;
+	const char *label;
+	const char *recordDir;
+	int keepFiles;
+	int codecMode;
+	int selfTest;
+	int codecThreads[MAX_LIST];
+	int numCodecThreads;
+	const char *codecInput;
+} BENCH_OPTIONS;
+
+typedef struct tagPERCENTILES
+{
+	double p50;
+	double p90;
+	double p99;
+	double max;
+	size_t count;
+} PERCENTILES;
+
+// Shared between the pipeline thread (callbacks) and the main thread.
+typedef struct tagBENCH_CONTEXT
+{
+	void *convertBuffer;
+	volatile int measuring; // Samples are only kept inside the measurement window.
+
+	// Written by the pipeline thread only.
+	volatile unsigned long frames;
+	std::vector<uint32_t> transport; // Frame received -> picked up by the pipeline.
+	std::vector<uint32_t> process;	 // Sink processing.
+	std::vector<uint32_t> total;	 // Frame received -> sink done.
+} BENCH_CONTEXT;
+
+//=============================================================================
+// Sinks
+
+// Stand-in for ConvertGevImageToX11Format() (display sink).
+static void ConvertForDisplay(GEV_BUFFER_OBJECT *img, void *context)
+{
+	void *dst = ((BENCH_CONTEXT *)context)->convertBuffer;
+	UINT32 w = img->w;
+	UINT32 h = img->h;
+	UINT32 x, y;
+
+	if (GevIsPixelTypeBayer(img->format))
+	{
+		// 2x2 block demosaic (RGGB) to RGBA.
+		int shift = (GevGetPixelDepthInBits(img->format) > 8) ? 8 : 0;
+		UINT32 *out = (UINT32 *)dst;
+
+		for (y = 0; y + 1 < h; y += 2)
+		{
+			for (x = 0; x + 1 < w; x += 2)
+			{
+				UINT32 r, g, b, rgba;
+				if (shift)
+				{
+					const UINT16 *p0 = (const UINT16 *)img->address + (size_t)y * w + x;
+					const UINT16 *p1 = p0 + w;
+					r = p0[0] >> shift;
+					g = ((UINT32)p0[1] + p1[0]) >> (shift + 1);
+					b = p1[1] >> shift;
+				}
+				else
+				{
+					const UINT8 *p0 = img->address + (size_t)y * w + x;
+					const UINT8 *p1 = p0 + w;
+					r = p0[0];
+					g = ((UINT32)p0[1] + p1[0]) >> 1;
+					b = p1[1];
+				}
+				rgba = 0xFF000000 | (r << 16) | (g << 8) | b;
+				out[(size_t)y * w + x] = rgba;
+				out[(size_t)y * w + x + 1] = rgba;
+				out[(size_t)(y + 1) * w + x] = rgba;
+				out[(size_t)(y + 1) * w + x + 1] = rgba;
+			}
+		}
+	}
+	else if (GevGetPixelDepthInBits(img->format) > 8)
+	{
+		const UINT16 *in = (const UINT16 *)img->address;
+		UINT8 *out = (UINT8 *)dst;
+		size_t i;
+
+		for (i = 0; i < (size_t)w * h; i++)
+		{
+			out[i] = (UINT8)(in[i] >> 8);
+		}
+	}
+	else
+	{
+		memcpy(dst, img->address, (size_t)w * h);
+	}
+}
+
+//=============================================================================
+// Pipeline timing (frame_pipeline frameDone callback)
+
+static void FrameDone(GEV_BUFFER_OBJECT *img, uint64_t t_start_us, uint64_t t_done_us, void *context)
+{
+	BENCH_CONTEXT *bench = (BENCH_CONTEXT *)context;
+
+	// (The synthetic camera time stamps frames with the same monotonic clock.)
+	if (bench->measuring)
+	{
+		bench->frames++;
+		bench->transport.push_back((uint32_t)(t_start_us - img->timestamp));
+		bench->process.push_back((uint32_t)(t_done_us - t_start_us));
+		bench->total.push_back((uint32_t)(t_done_us - img->timestamp));
+	}
+}
+
+//=============================================================================
+// Control round trip : a client thread polls "stats" while the main thread serves it.
+
+typedef struct tagCMD_POLLER
+{
+	CTL_QUEUE *queue;
+	volatile int exit;
+	std::vector<uint32_t> rtt;
+} CMD_POLLER;
+
+static void *CommandPollerThread(void *context)
+{
+	CMD_POLLER *poller = (CMD_POLLER *)context;
+
+	while (!poller->exit)
+	{
+		CTL_COMMAND cmd;
+
+		CtlParseCommand("stats", &cmd);
+		if (CtlSubmit(poller->queue, &cmd) != 0)
+		{
+			break;
+		}
+		poller->rtt.push_back((uint32_t)(cmd.t_done - cmd.t_submit));
+		usleep(CMD_POLL_PERIOD_MS * 1000);
+	}
+	return NULL;
+}
+
+//=============================================================================
+// Results
+
+static PERCENTILES ComputePercentiles(std::vector<uint32_t> &samples)
+{
+	PERCENTILES p = {0};
+	size_t n = samples.size();
+
+	p.count = n;
+	if (n == 0)
+	{
+		return p;
+	}
+	std::sort(samples.begin(), samples.end());
+	p.p50 = samples[(n * 50) / 100];
+	p.p90 = samples[(n * 90) / 100];
+	p.p99 = samples[std::min(n - 1, (n * 99) / 100)];
+	p.max = samples[n - 1];
+	return p;
+}
+
+static void PrintPercentilesJson(FILE *fp, const char *name, const PERCENTILES *p, int last)
+{
+	fprintf(fp, "        \"%s\": {\"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f, \"max\": %.0f, \"count\": %zu}%s\n",
+			name, p->p50, p->p90, p->p99, p->max, p->count, last ? "" : ",");
+}
+
+static double CpuTimeUs(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+//=============================================================================
+// Scenario
+
+static int RunScenario(const BENCH_OPTIONS *options, const BENCH_SCENARIO *scenario, int run, FILE *fp, int first)
+{
+	SYNTH_CAMERA_CONFIG config = {0};
+	GEV_CAMERA_HANDLE handle = NULL;
+	BENCH_CONTEXT bench;
+	FRAME_PIPELINE pipeline;
+	CMD_POLLER poller;
+	CTL_QUEUE cmdQueue;
+	FRAME_RECORDER recorder;
+	FRAME_CODEC codec;
+	int codecReady = 0;
+	RECORD_STATS recStart = {0};
+	RECORD_STATS recStats = {0};
+	SYNTH_STATS synthStart, synthEnd;
+	PUINT8 bufAddress[NUM_BUF];
+	char recordFile[512] = {0};
+	pthread_t pipelineTid, pollerTid;
+	UINT64 size, tStart, tEnd, tWindow = 0;
+	double cpuStart = 0.0, cpuEnd;
+	unsigned long commandsServed = 0;
+	int i;
+
+	config.width = scenario->width;
+	config.height = scenario->height;
+	config.format = scenario->format->format;
+	config.fps = scenario->fps;
+	if (SynthOpenCamera(&config, &handle) != GEVLIB_OK)
+	{
+		fprintf(logFp, "%s : error opening synthetic camera\n", scenario->name);
+		return -1;
+	}
+
+	size = (UINT64)scenario->width * scenario->height * GetPixelSizeInBytes(config.format);
+	for (i = 0; i < NUM_BUF; i++)
+	{
+		bufAddress[i] = (PUINT8)malloc(size);
+		memset(bufAddress[i], 0, size);
+	}
+	GevInitializeTransfer(handle, Asynchronous, size, NUM_BUF, bufAddress);
+
+	bench.convertBuffer = malloc((size_t)scenario->width * scenario->height * 4);
+	bench.measuring = 0;
+	bench.frames = 0;
+
+	PipelineInit(&pipeline);
+	pipeline.camHandle = handle;
+	pipeline.timeoutMs = 100;
+	pipeline.recorder = ((scenario->sink == SINK_RECORD) || (scenario->sink == SINK_RECORD_CODEC)) ? &recorder : NULL;
+	pipeline.display = (scenario->sink == SINK_CONVERT) ? ConvertForDisplay : NULL;
+	pipeline.frameDone = FrameDone;
+	pipeline.context = &bench;
+
+	RecorderInit(&recorder);
+	if (scenario->sink == SINK_RECORD_CODEC)
+	{
+		// Same thread count as image_display : one CPU is left for the receive loop.
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		if (CodecInit(&codec, (cpus > 1) ? (int)(cpus - 1) : 1) == 0)
+		{
+			codecReady = 1;
+			RecorderSetCodec(&recorder, &codec, GetPixelSizeInBytes(config.format), GevIsPixelTypeBayer(config.format));
+		}
+	}
+	if ((scenario->sink == SINK_RECORD) || (scenario->sink == SINK_RECORD_CODEC))
+	{
+		snprintf(recordFile, sizeof(recordFile), "%s/image_bench_%d.%s", options->recordDir, (int)getpid(),
+				 (scenario->sink == SINK_RECORD_CODEC) ? "gvc" : "raw");
+		if (RecorderStart(&recorder, recordFile, size) != 0)
+		{
+			fprintf(logFp, "%s : error opening %s\n", scenario->name, recordFile);
+		}
+	}
+
+	CtlQueueInit(&cmdQueue);
+	poller.queue = &cmdQueue;
+	poller.exit = 0;
+
+	pthread_create(&pipelineTid, NULL, PipelineThread, &pipeline);
+	pthread_create(&pollerTid, NULL, CommandPollerThread, &poller);
+	GevStartTransfer(handle, (UINT32)-1);
+
+	// Serve commands until the end of the run; open the measurement window after the warm up.
+	tStart = SynthTimeUs();
+	tEnd = tStart + (UINT64)(options->warmupMs + options->durationMs) * 1000;
+	while (SynthTimeUs() < tEnd)
+	{
+		CTL_COMMAND *cmd;
+
+		if (!bench.measuring && (SynthTimeUs() >= tStart + (UINT64)options->warmupMs * 1000))
+		{
+			SynthGetStats(handle, &synthStart);
+			RecorderGetStats(&recorder, &recStart);
+			cpuStart = CpuTimeUs();
+			tWindow = SynthTimeUs();
+			bench.measuring = 1;
+		}
+
+		cmd = CtlWaitCommand(&cmdQueue, 10);
+		if (cmd != NULL)
+		{
+			RECORD_STATS stats;
+
+			RecorderGetStats(&recorder, &stats);
+			snprintf(cmd->reply, sizeof(cmd->reply), "frames=%lu rec_frames=%llu", bench.frames,
+					 (unsigned long long)stats.framesWritten);
+			cmd->status = 0;
+			CtlComplete(&cmdQueue, cmd);
+			commandsServed++;
+		}
+	}
+	bench.measuring = 0;
+	tEnd = SynthTimeUs();
+	cpuEnd = CpuTimeUs();
+	SynthGetStats(handle, &synthEnd);
+
+	CtlQueueShutdown(&cmdQueue);
+	poller.exit = 1;
+	pthread_join(pollerTid, NULL);
+
+	GevStopTransfer(handle);
+	pipeline.exit = TRUE;
+	pthread_join(pipelineTid, NULL);
+
+	RecorderStop(&recorder);
+	RecorderGetStats(&recorder, &recStats);
+	if (codecReady)
+	{
+		CodecRelease(&codec);
+	}
+	if (recordFile[0] && !options->keepFiles)
+	{
+		unlink(recordFile);
+	}
+
+	// Results.
+	{
+		double seconds = (tEnd - tWindow) / 1e6;
+		unsigned long frames = bench.frames;
+		double fps = (seconds > 0.0) ? (frames / seconds) : 0.0;
+		double pipelineCpu = (cpuEnd - cpuStart) - (double)(synthEnd.cpuUs - synthStart.cpuUs);
+		double cpuPerFrame = frames ? (pipelineCpu / frames) : 0.0;
+		double mbPerSec = fps * size / 1e6;
+		UINT64 sourceDrops = synthEnd.framesDropped - synthStart.framesDropped;
+		UINT64 sinkDrops = recStats.framesDropped - recStart.framesDropped;
+		// (Frames still queued in the recorder at the end of the window are written while it stops.)
+		UINT64 sinkFrames = recStats.framesWritten - recStart.framesWritten;
+		double sinkMbPerSec = (seconds > 0.0) ? ((recStats.bytesWritten - recStart.bytesWritten) / seconds / 1e6) : 0.0;
+		PERCENTILES transport = ComputePercentiles(bench.transport);
+		PERCENTILES process = ComputePercentiles(bench.process);
+		PERCENTILES total = ComputePercentiles(bench.total);
+		PERCENTILES rtt = ComputePercentiles(poller.rtt);
+
+		// (For the record sinks fps counts the frames offered to the recorder : the recorded rate is sinkFrames.)
+		fprintf(logFp, "%-36s %2d %9.1f fps %8.1f MB/s %8.1f cpu_us/frame  total p50/p99 %6.0f/%6.0f us  drops %llu/%llu  cmd p99 %4.0f us",
+			   scenario->name, run + 1, fps, mbPerSec, cpuPerFrame, total.p50, total.p99,
+			   (unsigned long long)sourceDrops, (unsigned long long)sinkDrops, rtt.p99);
+		if (pipeline.recorder != NULL)
+		{
+			fprintf(logFp, "  recorded %.1f fps", (seconds > 0.0) ? (sinkFrames / seconds) : 0.0);
+		}
+		fprintf(logFp, "\n");
+
+		fprintf(fp, "%s    {\n", first ? "" : ",\n");
+		fprintf(fp, "      \"name\": \"%s\",\n", scenario->name);
+		fprintf(fp, "      \"run\": %d,\n", run);
+		fprintf(fp, "      \"width\": %u, \"height\": %u, \"pixel_format\": \"%s\", \"target_fps\": %g, \"sink\": \"%s\",\n",
+				scenario->width, scenario->height, scenario->format->name, scenario->fps, sinkName[scenario->sink]);
+		fprintf(fp, "      \"frames\": %lu,\n", frames);
+		fprintf(fp, "      \"seconds\": %.3f,\n", seconds);
+		fprintf(fp, "      \"fps\": %.2f,\n", fps);
+		fprintf(fp, "      \"mb_per_s\": %.2f,\n", mbPerSec);
+		fprintf(fp, "      \"cpu_us_per_frame\": %.2f,\n", cpuPerFrame);
+		fprintf(fp, "      \"drops\": {\"source\": %llu, \"sink\": %llu},\n",
+				(unsigned long long)sourceDrops, (unsigned long long)sinkDrops);
+		if ((scenario->sink == SINK_RECORD) || (scenario->sink == SINK_RECORD_CODEC))
+		{
+			// mb_per_s : bytes written to disk. ratio : frame bytes / bytes written.
+			UINT64 written = recStats.bytesWritten - recStart.bytesWritten;
+			UINT64 raw = recStats.rawBytes - recStart.rawBytes;
+			fprintf(fp, "      \"record\": {\"frames\": %llu, \"fps\": %.2f, \"mb_per_s\": %.2f, \"ratio\": %.3f, \"write_error\": %d},\n",
+					(unsigned long long)sinkFrames, (seconds > 0.0) ? (sinkFrames / seconds) : 0.0, sinkMbPerSec,
+					written ? ((double)raw / written) : 0.0, recStats.writeError);
+		}
+		fprintf(fp, "      \"latency_us\": {\n");
+		PrintPercentilesJson(fp, "transport", &transport, 0);
+		PrintPercentilesJson(fp, "process", &process, 0);
+		PrintPercentilesJson(fp, "total", &total, 1);
+		fprintf(fp, "      },\n");
+		fprintf(fp, "      \"cmd_rtt_us\": {\"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f, \"max\": %.0f, \"count\": %zu}\n",
+				rtt.p50, rtt.p90, rtt.p99, rtt.max, rtt.count);
+		fprintf(fp, "    }");
+	}
+
+	GevFreeTransfer(handle);
+	SynthCloseCamera(&handle);
+	for (i = 0; i < NUM_BUF; i++)
+	{
+		free(bufAddress[i]);
+	}
+	free(bench.convertBuffer);
+	return 0;
+}
+
+//=============================================================================
+// Codec (--codec)
+
+typedef struct tagCODEC_INPUT
+{
+	char name[96];
+	UINT32 width;
+	UINT32 height;
+	int bytesPerPixel;
+	int bayer;
+	size_t frameSize;
+	std::vector<void *> frames;
+} CODEC_INPUT;
+
+static void FreeCodecInput(CODEC_INPUT *input)
+{
+	size_t i;
+
+	for (i = 0; i < input->frames.size(); i++)
+	{
+		free(input->frames[i]);
+	}
+	input->frames.clear();
+}
+
+static int LoadSyntheticFrames(CODEC_INPUT *input, UINT32 width, UINT32 height, const BENCH_FORMAT *format)
+{
+	int i;
+
+	snprintf(input->name, sizeof(input->name), "%ux%u/%s", width, height, format->name);
+	input->width = width;
+	input->height = height;
+	input->bytesPerPixel = (int)GetPixelSizeInBytes(format->format);
+	input->bayer = GevIsPixelTypeBayer(format->format) ? 1 : 0;
+	input->frameSize = (size_t)width * height * input->bytesPerPixel;
+	for (i = 0; i < CODEC_MAX_FRAMES / 2; i++)
+	{
+		void *frame = malloc(input->frameSize);
+		if (frame == NULL)
+		{
+			return -1;
+		}
+		SynthFillPattern(frame, width, height, format->format, (UINT32)i);
+		input->frames.push_back(frame);
+	}
+	return 0;
+}
+
+// Reads up to CODEC_MAX_FRAMES frames of a recording (image_display 'record' or the record sinks).
+// Only frames with the geometry of the first frame are kept. A truncated or inconsistent frame fails
+// the whole file.
+static int LoadRecordedFrames(CODEC_INPUT *input, const char *filename)
+{
+	const char *base = strrchr(filename, '/');
+	RECORD_FRAME_HEADER header;
+	CODEC_FRAME_HEADER codecHeader;
+	FRAME_CODEC decoder;
+	void *payload = NULL;
+	size_t capacity = 0;
+	size_t got;
+	UINT32 format = 0;
+	int status = 0;
+	FILE *fp;
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL)
+	{
+		fprintf(logFp, "Error opening %s\n", filename);
+		return -1;
+	}
+	if (CodecInit(&decoder, 0) != 0)
+	{
+		fclose(fp);
+		return -1;
+	}
+	snprintf(input->name, sizeof(input->name), "file:%s", (base != NULL) ? (base + 1) : filename);
+
+	while ((input->frames.size() < CODEC_MAX_FRAMES) && ((got = fread(&header, 1, sizeof(header), fp)) != 0))
+	{
+		void *frame;
+
+		if (got != sizeof(header))
+		{
+			fprintf(logFp, "%s : truncated frame header\n", filename);
+			status = -1;
+			break;
+		}
+		if (header.magic == RECORD_FRAME_MAGIC_V1)
+		{
+			fprintf(logFp, "%s : recorded in the first format (no encoding field) - not supported\n", filename);
+			status = -1;
+			break;
+		}
+		if ((header.magic != RECORD_FRAME_MAGIC) ||
+			((header.encoding != RECORD_ENCODING_RAW) && (header.encoding != RECORD_ENCODING_CODEC)) ||
+			((header.encoding == RECORD_ENCODING_RAW) && (header.size != header.rawSize)))
+		{
+			fprintf(logFp, "%s : bad frame header\n", filename);
+			status = -1;
+			break;
+		}
+		if (capacity < header.size)
+		{
+			free(payload);
+			payload = malloc(header.size);
+			capacity = (payload != NULL) ? header.size : 0;
+		}
+		if ((payload == NULL) || (fread(payload, 1, header.size, fp) != header.size))
+		{
+			fprintf(logFp, "%s : truncated frame\n", filename);
+			status = -1;
+			break;
+		}
+
+		if (input->frames.empty())
+		{
+			input->width = header.width;
+			input->height = header.height;
+			input->frameSize = header.rawSize;
+			input->bytesPerPixel = (header.width && header.height) ? (int)(header.rawSize / ((size_t)header.width * header.height)) : 0;
+			input->bayer = GevIsPixelTypeBayer(header.format) ? 1 : 0;
+			format = header.format;
+			if (((input->bytesPerPixel != 1) && (input->bytesPerPixel != 2)) ||
+				((size_t)header.width * header.height * input->bytesPerPixel != header.rawSize))
+			{
+				fprintf(logFp, "%s : unsupported frame (%ux%u, %u bytes)\n", filename, header.width, header.height, header.rawSize);
+				status = -1;
+				break;
+			}
+		}
+		else if ((header.width != input->width) || (header.height != input->height) || (header.format != format))
+		{
+			continue;
+		}
+		else if (header.rawSize != input->frameSize)
+		{
+			fprintf(logFp, "%s : bad frame header\n", filename);
+			status = -1;
+			break;
+		}
+
+		frame = malloc(input->frameSize);
+		if (frame == NULL)
+		{
+			status = -1;
+			break;
+		}
+		if (header.encoding == RECORD_ENCODING_CODEC)
+		{
+			// (The compressed frame must fill the whole frame.)
+			if ((CodecGetFrameInfo(payload, header.size, &codecHeader) != 0) || (codecHeader.width != header.width) ||
+				(codecHeader.height != header.height) || (codecHeader.bytesPerPixel != input->bytesPerPixel) ||
+				(CodecDecompress(&decoder, payload, header.size, frame, input->frameSize) != 0))
+			{
+				fprintf(logFp, "%s : corrupt compressed frame %u\n", filename, header.id);
+				free(frame);
+				status = -1;
+				break;
+			}
+		}
+		else
+		{
+			memcpy(frame, payload, input->frameSize);
+		}
+		input->frames.push_back(frame);
+	}
+
+	free(payload);
+	CodecRelease(&decoder);
+	fclose(fp);
+	if ((status == 0) && input->frames.empty())
+	{
+		fprintf(logFp, "%s : no frames\n", filename);
+		status = -1;
+	}
+	return status;
+}
+
+// Records the frames of the input with frame_recorder (codec = NULL : uncompressed) until durationMs has
+// elapsed, then syncs the file. Frames are offered again when the recorder is full, so this is the
+// rate the recorder sustains with compression and writes overlapped.
+// Returns the frame data rate in MB/s (uncompressed bytes), or -1 on error.
+static double TimeWrite(const char *filename, CODEC_INPUT *input, FRAME_CODEC *codec, unsigned int durationMs)
+{
+	FRAME_RECORDER recorder;
+	RECORD_STATS stats;
+	UINT64 t0, t1;
+	int fd, error;
+	size_t i;
+
+	RecorderInit(&recorder);
+	RecorderSetCodec(&recorder, codec, input->bytesPerPixel, input->bayer);
+	if (RecorderStart(&recorder, filename, input->frameSize) != 0)
+	{
+		return -1.0;
+	}
+
+	t0 = SynthTimeUs();
+	do
+	{
+		for (i = 0; i < input->frames.size(); i++)
+		{
+			while (RecorderOfferFrame(&recorder, input->frames[i], input->frameSize, (uint32_t)i, SynthTimeUs(),
+									  input->width, input->height, 0) != 0)
+			{
+				usleep(100);
+			}
+		}
+	} while (SynthTimeUs() - t0 < (UINT64)durationMs * 1000);
+	RecorderStop(&recorder);
+	RecorderGetStats(&recorder, &stats);
+
+	// (fsync flushes the file whatever descriptor it is called on.)
+	fd = open(filename, O_RDONLY);
+	error = stats.writeError || (fd < 0) || (fsync(fd) != 0);
+	t1 = SynthTimeUs();
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+	unlink(filename);
+
+	return (error || (t1 == t0)) ? -1.0 : ((double)stats.framesWritten * input->frameSize / (double)(t1 - t0));
+}
+
+static int RunCodec(const BENCH_OPTIONS *options, CODEC_INPUT *input, int numThreads, FILE *fp, int first)
+{
+	FRAME_CODEC codec;
+	CODEC_STATS start, end;
+	size_t capacity = CodecMaxCompressedSize(input->width, input->height, input->bytesPerPixel);
+	size_t n = input->frames.size();
+	std::vector<void *> compressed(n, (void *)NULL);
+	std::vector<size_t> compressedSize(n, 0);
+	void *check = malloc(input->frameSize);
+	char name[128];
+	char writeFile[512];
+	UINT64 t0, decodeUs, decodeBytes = 0;
+	double ratio, compressMbPerSec, mbPerSecCore, decompressMbPerSec, writeRaw, writeCodec;
+	int lossless = 1;
+	int error = 0;
+	size_t i;
+
+	snprintf(name, sizeof(name), "codec/%s/t%d", input->name, numThreads);
+	if (CodecInit(&codec, numThreads) != 0)
+	{
+		fprintf(logFp, "%s : error starting the codec\n", name);
+		free(check);
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+	{
+		compressed[i] = malloc(capacity);
+		error |= (compressed[i] == NULL);
+	}
+	error |= (check == NULL);
+
+	// Compression, over the frame set until the duration has elapsed.
+	CodecGetStats(&codec, &start);
+	t0 = SynthTimeUs();
+	do
+	{
+		for (i = 0; (i < n) && !error; i++)
+		{
+			compressedSize[i] = CodecCompress(&codec, input->frames[i], input->width, input->height,
+											  input->bytesPerPixel, input->bayer, compressed[i], capacity);
+			error |= (compressedSize[i] == 0);
+		}
+	} while (!error && (SynthTimeUs() - t0 < (UINT64)options->durationMs * 1000));
+	CodecGetStats(&codec, &end);
+
+	// Decompression (same time budget), checking the first pass against the source.
+	t0 = SynthTimeUs();
+	do
+	{
+		for (i = 0; (i < n) && !error; i++)
+		{
+			if (CodecDecompress(&codec, compressed[i], compressedSize[i], check, input->frameSize) != 0)
+			{
+				lossless = 0;
+			}
+			else if ((decodeBytes < (UINT64)n * input->frameSize) && memcmp(check, input->frames[i], input->frameSize))
+			{
+				lossless = 0;
+			}
+			decodeBytes += input->frameSize;
+		}
+	} while (!error && (SynthTimeUs() - t0 < (UINT64)options->durationMs * 1000));
+	decodeUs = SynthTimeUs() - t0;
+
+	// Recording to disk : uncompressed vs compressed (frame_recorder, compression included).
+	snprintf(writeFile, sizeof(writeFile), "%s/image_bench_%d.codec", options->recordDir, (int)getpid());
+	writeRaw = error ? -1.0 : TimeWrite(writeFile, input, NULL, options->durationMs);
+	writeCodec = error ? -1.0 : TimeWrite(writeFile, input, &codec, options->durationMs);
+
+	CodecRelease(&codec);
+	for (i = 0; i < n; i++)
+	{
+		free(compressed[i]);
+	}
+	free(check);
+	if (error)
+	{
+		fprintf(logFp, "%s : compression failed\n", name);
+		return -1;
+	}
+
+	{
+		UINT64 rawBytes = end.rawBytes - start.rawBytes;
+		UINT64 compressedBytes = end.compressedBytes - start.compressedBytes;
+		UINT64 cpuUs = end.cpuUs - start.cpuUs;
+		UINT64 wallUs = end.wallUs - start.wallUs;
+
+		ratio = compressedBytes ? ((double)rawBytes / compressedBytes) : 0.0;
+		compressMbPerSec = wallUs ? ((double)rawBytes / wallUs) : 0.0;
+		mbPerSecCore = cpuUs ? ((double)rawBytes / cpuUs) : 0.0;
+		decompressMbPerSec = decodeUs ? ((double)decodeBytes / decodeUs) : 0.0;
+	}
+
+	fprintf(logFp, "%-36s ratio %5.2f  compress %8.1f MB/s %7.1f MB/s/core  decompress %8.1f MB/s  write raw/codec %8.1f/%8.1f MB/s%s\n",
+			name, ratio, compressMbPerSec, mbPerSecCore, decompressMbPerSec, writeRaw, writeCodec,
+			lossless ? "" : "  NOT LOSSLESS");
+
+	fprintf(fp, "%s    {\n", first ? "" : ",\n");
+	fprintf(fp, "      \"name\": \"%s\",\n", name);
+	fprintf(fp, "      \"width\": %u, \"height\": %u, \"bytes_per_pixel\": %d, \"bayer\": %d, \"threads\": %d, \"frames\": %zu,\n",
+			input->width, input->height, input->bytesPerPixel, input->bayer, numThreads, n);
+	fprintf(fp, "      \"ratio\": %.4f,\n", ratio);
+	fprintf(fp, "      \"compress_mb_per_s\": %.2f,\n", compressMbPerSec);
+	fprintf(fp, "      \"mb_per_s_core\": %.2f,\n", mbPerSecCore);
+	fprintf(fp, "      \"decompress_mb_per_s\": %.2f,\n", decompressMbPerSec);
+	fprintf(fp, "      \"lossless\": %s,\n", lossless ? "true" : "false");
+	fprintf(fp, "      \"write_raw_mb_per_s\": %.2f,\n", writeRaw);
+	fprintf(fp, "      \"write_codec_mb_per_s\": %.2f\n", writeCodec);
+	fprintf(fp, "    }");
+	return 0;
+}
+
+//=============================================================================
+// Self test (--selftest)
+//
+// Codec round trips on edge case geometries (odd widths, widths below CODEC_BLOCK, fewer rows
+// than a band, Bayer mosaics) with one and several threads, recordings written by frame_recorder
+// and read back with LoadRecordedFrames(), and rejection of corrupt compressed frames and
+// recordings. Meant to be run under the sanitizers too (make selftest SANITIZE=...).
+
+#define SELFTEST_GUARD 64 // Bytes after a decoded frame that must stay untouched.
+#define SELFTEST_FRAMES 10
+
+typedef enum
+{
+	PATTERN_SYNTHETIC = 0, // Gradient + noise (compresses).
+	PATTERN_RANDOM,		   // Full range noise (does not compress : stored raw in a recording).
+	PATTERN_EXTREMES,	   // Checkerboard of 0 and full scale (largest residuals).
+	NUM_PATTERNS
+} SELFTEST_PATTERN;
+
+static const char *patternName[NUM_PATTERNS] = {"synthetic", "random", "extremes"};
+
+static int selfTestChecks = 0;
+static int selfTestFailures = 0;
+
+static int SelfTestCheck(int ok, const char *format, ...)
+{
+	selfTestChecks++;
+	if (!ok)
+	{
+		va_list args;
+
+		fprintf(logFp, "FAILED : ");
+		va_start(args, format);
+		vfprintf(logFp, format, args);
+		va_end(args);
+		fprintf(logFp, "\n");
+		selfTestFailures++;
+	}
+	return ok;
+}
+
+static void FillTestFrame(void *frame, UINT32 width, UINT32 height, UINT32 format, SELFTEST_PATTERN pattern, UINT32 seed)
+{
+	size_t bytesPerPixel = GetPixelSizeInBytes(format);
+	size_t size = (size_t)width * height * bytesPerPixel;
+	UINT32 lcg = seed * 2654435761u + 1;
+	size_t i;
+
+	switch (pattern)
+	{
+	case PATTERN_SYNTHETIC:
+		SynthFillPattern(frame, width, height, format, seed);
+		break;
+	case PATTERN_RANDOM:
+		for (i = 0; i < size; i++)
+		{
+			lcg = lcg * 1664525u + 1013904223u;
+			((UINT8 *)frame)[i] = (UINT8)(lcg >> 24);
+		}
+		break;
+	default:
+		for (i = 0; i < size; i++)
+		{
+			size_t pixel = i / bytesPerPixel;
+			((UINT8 *)frame)[i] = (((pixel % width) + (pixel / width)) & 1) ? 0xFF : 0x00;
+		}
+		break;
+	}
+}
+
+static int GuardIntact(const UINT8 *guard)
+{
+	int i;
+
+	for (i = 0; i < SELFTEST_GUARD; i++)
+	{
+		if (guard[i] != 0xA5)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void SelfTestCodec(FRAME_CODEC *codec)
+{
+	static const UINT32 geometry[][2] = {
+		{1, 1}, {2, 2}, {3, 5},	// Tiny frames (a single pixel per Bayer colour or less).
+		{5, 40}, {31, 17},		// Narrower than a block.
+		{33, 7}, {97, 3},		// Odd widths, fewer rows than a band.
+		{640, 15},				// Fewer rows than a band.
+		{1001, 67},				// Odd width, several bands, partial last block and band.
+	};
+	size_t f, g;
+	int p;
+
+	for (f = 0; f < sizeof(formatList) / sizeof(formatList[0]); f++)
+	{
+		for (g = 0; g < sizeof(geometry) / sizeof(geometry[0]); g++)
+		{
+			UINT32 width = geometry[g][0];
+			UINT32 height = geometry[g][1];
+			int bytesPerPixel = (int)GetPixelSizeInBytes(formatList[f].format);
+			int bayer = GevIsPixelTypeBayer(formatList[f].format) ? 1 : 0;
+			size_t size = (size_t)width * height * bytesPerPixel;
+			size_t capacity = CodecMaxCompressedSize(width, height, bytesPerPixel);
+			UINT8 *src = (UINT8 *)malloc(size);
+			UINT8 *compressed = (UINT8 *)malloc(capacity);
+			UINT8 *check = (UINT8 *)malloc(size + SELFTEST_GUARD);
+
+			for (p = 0; p < NUM_PATTERNS; p++)
+			{
+				size_t n;
+
+				FillTestFrame(src, width, height, formatList[f].format, (SELFTEST_PATTERN)p, (UINT32)g);
+				memset(check, 0xA5, size + SELFTEST_GUARD);
+				n = CodecCompress(codec, src, width, height, bytesPerPixel, bayer, compressed, capacity);
+				if (SelfTestCheck((n > 0) && (n <= capacity), "codec t%d %ux%u %s %s : compress returned %zu (max %zu)",
+								  codec->numThreads, width, height, formatList[f].name, patternName[p], n, capacity))
+				{
+					SelfTestCheck((CodecDecompress(codec, compressed, n, check, size) == 0) && !memcmp(check, src, size) &&
+									  GuardIntact(check + size),
+								  "codec t%d %ux%u %s %s : round trip", codec->numThreads, width, height,
+								  formatList[f].name, patternName[p]);
+				}
+			}
+			free(src);
+			free(compressed);
+			free(check);
+		}
+	}
+}
+
+// Every truncation and header field corruption of a compressed frame (n bytes, band data from
+// 'data', decoding to 'size' bytes) must be rejected; random byte flips in the band data may decode
+// to garbage but never write outside the frame.
+static void SelfTestCodecCorruptFrame(FRAME_CODEC *codec, const UINT8 *compressed, size_t n, size_t data, size_t size)
+{
+	UINT8 *bad = (UINT8 *)malloc(n);
+	UINT8 *check = (UINT8 *)malloc(size + SELFTEST_GUARD);
+	CODEC_FRAME_HEADER *h = (CODEC_FRAME_HEADER *)bad;
+	uint32_t *bandSize = (uint32_t *)(bad + sizeof(CODEC_FRAME_HEADER));
+	UINT32 lcg = 12345;
+	size_t len;
+	int i;
+
+	for (len = 0; len < n; len++)
+	{
+		SelfTestCheck(CodecDecompress(codec, compressed, len, check, size) != 0, "corrupt : truncated to %zu of %zu bytes accepted",
+					  len, n);
+	}
+
+#define CORRUPT_FIELD(what, change)                                                             \
+	memcpy(bad, compressed, n);                                                                 \
+	change;                                                                                     \
+	SelfTestCheck(CodecDecompress(codec, bad, n, check, size) != 0, "corrupt : %s accepted", what)
+
+	CORRUPT_FIELD("bad magic", h->magic ^= 1);
+	CORRUPT_FIELD("bad version", h->version++);
+	CORRUPT_FIELD("3 bytes per pixel", h->bytesPerPixel = 3);
+	CORRUPT_FIELD("no bands", h->numBands = 0);
+	CORRUPT_FIELD("too many bands", h->numBands = CODEC_MAX_BANDS + 1);
+	CORRUPT_FIELD("no band rows", h->bandRows = 0);
+	CORRUPT_FIELD("frame larger than the buffer", h->height += 1);
+	CORRUPT_FIELD("band past the end", bandSize[0] += 1);
+	CORRUPT_FIELD("zeroed band data", memset(bad + data, 0, n - data));
+#undef CORRUPT_FIELD
+
+	for (i = 0; i < 500; i++)
+	{
+		memcpy(bad, compressed, n);
+		lcg = lcg * 1664525u + 1013904223u;
+		bad[data + (lcg >> 8) % (n - data)] ^= (UINT8)(1 + (lcg & 0x7F));
+		memset(check, 0xA5, size + SELFTEST_GUARD);
+		CodecDecompress(codec, bad, n, check, size);
+		SelfTestCheck(GuardIntact(check + size), "corrupt : flipped band data written past the frame");
+	}
+
+	free(bad);
+	free(check);
+}
+
+// Corrupt copies of a compressed Mono16 frame.
+static void SelfTestCodecCorrupt(FRAME_CODEC *codec)
+{
+	const UINT32 width = 64;
+	const UINT32 height = 40;
+	const size_t size = (size_t)width * height * 2;
+	size_t capacity = CodecMaxCompressedSize(width, height, 2);
+	UINT8 *src = (UINT8 *)malloc(size);
+	UINT8 *compressed = (UINT8 *)malloc(capacity);
+	size_t n, data;
+
+	FillTestFrame(src, width, height, fmtMono16, PATTERN_SYNTHETIC, 1);
+	n = CodecCompress(codec, src, width, height, 2, 0, compressed, capacity);
+	data = sizeof(CODEC_FRAME_HEADER) + ((CODEC_FRAME_HEADER *)compressed)->numBands * sizeof(uint32_t);
+	if (SelfTestCheck((n > data), "corrupt : compress"))
+	{
+		SelfTestCodecCorruptFrame(codec, compressed, n, data, size);
+	}
+
+	free(src);
+	free(compressed);
+}
+
+// Records SELFTEST_FRAMES frames (all the patterns, so a compressed recording holds raw frames too)
+// and reads them back.
+static void SelfTestRecording(FRAME_CODEC *codec, const char *filename, UINT32 width, UINT32 height,
+							  const BENCH_FORMAT *format)
+{
+	FRAME_RECORDER recorder;
+	RECORD_STATS stats;
+	CODEC_INPUT source; // The frames recorded.
+	CODEC_INPUT input;	// The frames read back.
+	int bytesPerPixel = (int)GetPixelSizeInBytes(format->format);
+	int bayer = GevIsPixelTypeBayer(format->format) ? 1 : 0;
+	size_t size = (size_t)width * height * bytesPerPixel;
+	char name[128];
+	size_t i;
+
+	snprintf(name, sizeof(name), "recording %s %ux%u %s", codec ? "compressed" : "raw", width, height, format->name);
+	for (i = 0; i < SELFTEST_FRAMES; i++)
+	{
+		void *frame = malloc(size);
+
+		FillTestFrame(frame, width, height, format->format, (SELFTEST_PATTERN)(i % NUM_PATTERNS), (UINT32)i);
+		source.frames.push_back(frame);
+	}
+
+	RecorderInit(&recorder);
+	RecorderSetCodec(&recorder, codec, bytesPerPixel, bayer);
+	if (SelfTestCheck(RecorderStart(&recorder, filename, size) == 0, "%s : error opening %s", name, filename))
+	{
+		for (i = 0; i < source.frames.size(); i++)
+		{
+			// (Offered again until the recorder has room : every frame must be written.)
+			while (RecorderOfferFrame(&recorder, source.frames[i], size, (uint32_t)i, (uint64_t)i, width, height,
+									  format->format) != 0)
+			{
+				usleep(100);
+			}
+		}
+		RecorderStop(&recorder);
+		RecorderGetStats(&recorder, &stats);
+		SelfTestCheck((stats.framesWritten == source.frames.size()) && !stats.writeError,
+					  "%s : %llu of %zu frames written, write error %d", name, (unsigned long long)stats.framesWritten,
+					  source.frames.size(), stats.writeError);
+
+		if (SelfTestCheck(LoadRecordedFrames(&input, filename) == 0, "%s : read back failed", name))
+		{
+			SelfTestCheck((input.width == width) && (input.height == height) && (input.bytesPerPixel == bytesPerPixel) &&
+							  (input.bayer == bayer) && (input.frames.size() == source.frames.size()),
+						  "%s : read back %ux%u, %d bytes per pixel, bayer %d, %zu frames", name, input.width,
+						  input.height, input.bytesPerPixel, input.bayer, input.frames.size());
+			for (i = 0; (i < input.frames.size()) && (i < source.frames.size()); i++)
+			{
+				SelfTestCheck(!memcmp(input.frames[i], source.frames[i], size), "%s : frame %zu differs", name, i);
+			}
+		}
+		FreeCodecInput(&input);
+	}
+	FreeCodecInput(&source);
+}
+
+static int ReadFile(const char *filename, std::vector<UINT8> &data)
+{
+	FILE *fp = fopen(filename, "rb");
+	UINT8 buf[65536];
+	size_t n;
+
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+	{
+		data.insert(data.end(), buf, buf + n);
+	}
+	fclose(fp);
+	return 0;
+}
+
+static void ExpectRejected(const char *filename, const std::vector<UINT8> &data, const char *what)
+{
+	CODEC_INPUT input;
+	FILE *fp = fopen(filename, "wb");
+	FILE *log = logFp;
+	FILE *quiet;
+	int status;
+
+	if (fp != NULL)
+	{
+		fwrite(data.data(), 1, data.size(), fp);
+		fclose(fp);
+	}
+	// (The read error is expected : keep it out of the output.)
+	quiet = fopen("/dev/null", "w");
+	logFp = (quiet != NULL) ? quiet : log;
+	status = LoadRecordedFrames(&input, filename);
+	logFp = log;
+	if (quiet != NULL)
+	{
+		fclose(quiet);
+	}
+	SelfTestCheck(status != 0, "corrupt recording : %s accepted", what);
+	FreeCodecInput(&input);
+}
+
+// Frame headers are not aligned in a recording : they are copied in and out.
+static RECORD_FRAME_HEADER GetHeader(const std::vector<UINT8> &data, size_t offset)
+{
+	RECORD_FRAME_HEADER header;
+
+	memcpy(&header, data.data() + offset, sizeof(header));
+	return header;
+}
+
+static void PutHeader(std::vector<UINT8> &data, size_t offset, const RECORD_FRAME_HEADER *header)
+{
+	memcpy(data.data() + offset, header, sizeof(RECORD_FRAME_HEADER));
+}
+
+// Corrupted copies of a compressed recording (frame 0 compressed, frame 1 raw) must be rejected.
+static void SelfTestRecordingCorrupt(const char *goodFile, const char *badFile)
+{
+	std::vector<UINT8> good, bad;
+	RECORD_FRAME_HEADER first, second, h;
+	size_t secondOffset, secondData;
+
+	if (!SelfTestCheck(ReadFile(goodFile, good) == 0, "corrupt recording : error reading %s", goodFile))
+	{
+		return;
+	}
+	first = GetHeader(good, 0);
+	secondOffset = sizeof(RECORD_FRAME_HEADER) + first.size;
+	secondData = secondOffset + sizeof(RECORD_FRAME_HEADER);
+	second = GetHeader(good, secondOffset);
+	if (!SelfTestCheck((first.encoding == RECORD_ENCODING_CODEC) && (second.encoding == RECORD_ENCODING_RAW),
+					   "corrupt recording : expected a compressed then a raw frame"))
+	{
+		return;
+	}
+
+	bad = good;
+	h = first;
+	h.magic = RECORD_FRAME_MAGIC_V1;
+	PutHeader(bad, 0, &h);
+	ExpectRejected(badFile, bad, "first format magic");
+
+	bad = good;
+	h = second;
+	h.magic ^= 1;
+	PutHeader(bad, secondOffset, &h);
+	ExpectRejected(badFile, bad, "bad magic");
+
+	bad = good;
+	h = first;
+	h.encoding = 2;
+	PutHeader(bad, 0, &h);
+	ExpectRejected(badFile, bad, "unknown encoding");
+
+	bad = good;
+	bad.resize(secondOffset + sizeof(RECORD_FRAME_HEADER) / 2);
+	ExpectRejected(badFile, bad, "truncated header");
+
+	bad = good;
+	bad.resize(secondData + second.size / 2);
+	ExpectRejected(badFile, bad, "truncated frame");
+
+	bad = good;
+	h = second;
+	h.size--;
+	PutHeader(bad, secondOffset, &h);
+	bad.erase(bad.begin() + secondData);
+	ExpectRejected(badFile, bad, "raw frame shorter than the image");
+
+	bad = good;
+	h = first;
+	h.height++;
+	h.rawSize += h.width * 2;
+	PutHeader(bad, 0, &h);
+	ExpectRejected(badFile, bad, "compressed frame smaller than the image");
+
+	bad = good;
+	memset(bad.data() + sizeof(RECORD_FRAME_HEADER) + sizeof(CODEC_FRAME_HEADER), 0, first.size - sizeof(CODEC_FRAME_HEADER));
+	ExpectRejected(badFile, bad, "zeroed compressed data");
+}
+
+static int SelfTest(const BENCH_OPTIONS *options)
+{
+	FRAME_CODEC codec;
+	char goodFile[512], badFile[512];
+	int threads[2] = {1, 4};
+	int t;
+
+	snprintf(goodFile, sizeof(goodFile), "%s/image_bench_%d_selftest.gvc", options->recordDir, (int)getpid());
+	snprintf(badFile, sizeof(badFile), "%s/image_bench_%d_corrupt.gvc", options->recordDir, (int)getpid());
+
+	// (Several threads exercise the pool even on a single CPU.)
+	for (t = 0; t < 2; t++)
+	{
+		if (!SelfTestCheck(CodecInit(&codec, threads[t]) == 0, "codec : init with %d threads", threads[t]))
+		{
+			continue;
+		}
+		SelfTestCodec(&codec);
+		SelfTestCodecCorrupt(&codec);
+
+		SelfTestRecording(NULL, goodFile, 1001, 67, &formatList[3]);
+		SelfTestRecording(&codec, goodFile, 1001, 67, &formatList[3]);
+		SelfTestRecording(&codec, goodFile, 97, 3, &formatList[2]);
+		SelfTestRecording(&codec, goodFile, 640, 15, &formatList[1]);
+		SelfTestRecording(NULL, goodFile, 33, 7, &formatList[0]);
+		// (The last recording : Mono16 64x40, frame 0 compressed, frame 1 random so stored raw.)
+		SelfTestRecording(&codec, goodFile, 64, 40, &formatList[1]);
+		SelfTestRecordingCorrupt(goodFile, badFile);
+		CodecRelease(&codec);
+	}
+
+	unlink(goodFile);
+	unlink(badFile);
+
+	fprintf(logFp, "selftest : %d checks, %d failed\n", selfTestChecks, selfTestFailures);
+	return selfTestFailures ? -1 : 0;
+}
+
+//=============================================================================
+// Options
+
+static void PrintUsage(const char *prog)
+{
+	printf("Usage : %s [options]\n", prog);
+	printf("   --res WxH[,WxH...]        resolutions      (default 640x480,1280x1024,2048x1600)\n");
+	printf("   --format NAME[,NAME...]   Mono8, Mono16, BayerRG8, BayerRG16 (default Mono8,Mono16,BayerRG8)\n");
+	printf("   --fps N[,N...]            0 = maximum rate (default 30,0)\n");
+	printf("   --sink NAME[,NAME...]     none, convert, record, record_codec (default all)\n");
+	printf("   --duration MS             measurement time per scenario (default 2000)\n");
+	printf("   --warmup MS               warm up time per scenario (default 200)\n");
+	printf("   --repeat N                runs of every scenario, one pass over the matrix each (default 5)\n");
+	printf("   --quick                   small matrix for a fast check\n");
+	printf("   --out FILE                JSON results (default bench_results.json, '-' = stdout)\n");
+	printf("   --label TEXT              label stored in the results (e.g. the commit id)\n");
+	printf("   --dir PATH                directory for recorded files (default /tmp)\n");
+	printf("   --keep                    keep the recorded files\n");
+	printf("   --codec                   compression benchmark instead of the scenarios (uses --res, --format)\n");
+	printf("   --codec-threads N[,N...]  codec thread counts (default 1,<cpus>)\n");
+	printf("   --codec-input FILE        recording to compress instead of synthetic frames (implies --codec)\n");
+	printf("   --selftest                codec / recording round trip and corrupt data checks (uses --dir)\n");
+}
+
+static int ParseList(const char *arg, char items[MAX_LIST][32])
+{
+	char buf[256];
+	char *saveptr = NULL;
+	char *token;
+	int n = 0;
+
+	strncpy(buf, arg, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+	for (token = strtok_r(buf, ",", &saveptr); (token != NULL) && (n < MAX_LIST); token = strtok_r(NULL, ",", &saveptr))
+	{
+		strncpy(items[n], token, 31);
+		items[n][31] = '\0';
+		n++;
+	}
+	return n;
+}
+
+static int ParseOptions(int argc, char *argv[], BENCH_OPTIONS *options)
+{
+	static const struct option longOptions[] = {
+		{"res", required_argument, NULL, 'r'},
+		{"format", required_argument, NULL, 'p'},
+		{"fps", required_argument, NULL, 'f'},
+		{"sink", required_argument, NULL, 's'},
+		{"duration", required_argument, NULL, 'd'},
+		{"warmup", required_argument, NULL, 'w'},
+		{"repeat", required_argument, NULL, 'n'},
+		{"quick", no_argument, NULL, 'q'},
+		{"out", required_argument, NULL, 'o'},
+		{"label", required_argument, NULL, 'l'},
+		{"dir", required_argument, NULL, 'D'},
+		{"keep", no_argument, NULL, 'k'},
+		{"codec", no_argument, NULL, 'c'},
+		{"codec-threads", required_argument, NULL, 't'},
+		{"codec-input", required_argument, NULL, 'i'},
+		{"selftest", no_argument, NULL, 'T'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}};
+	char items[MAX_LIST][32];
+	int opt, n, i, j;
+
+	// Defaults.
+	memset(options, 0, sizeof(BENCH_OPTIONS));
+	options->width[0] = 640, options->height[0] = 480;
+	options->width[1] = 1280, options->height[1] = 1024;
+	options->width[2] = 2048, options->height[2] = 1600;
+	options->numRes = 3;
+	options->format[0] = &formatList[0];
+	options->format[1] = &formatList[1];
+	options->format[2] = &formatList[2];
+	options->numFormats = 3;
+	options->fps[0] = 30;
+	options->fps[1] = 0;
+	options->numFps = 2;
+	options->sink[0] = SINK_NONE;
+	options->sink[1] = SINK_CONVERT;
+	options->sink[2] = SINK_RECORD;
+	options->numSinks = 3;
+	options->durationMs = 2000;
+	options->warmupMs = 200;
+	options->repeat = 5;
+	options->outFile = "bench_results.json";
+	options->label = "";
+	options->recordDir = "/tmp";
+	options->codecThreads[0] = 1;
+	options->codecThreads[1] = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	options->numCodecThreads = (options->codecThreads[1] > 1) ? 2 : 1;
+
+	while ((opt = getopt_long(argc, argv, "h", longOptions, NULL)) != -1)
+	{
+		switch (opt)
+		{
+		case 'r':
+			n = ParseList(optarg, items);
+			for (i = 0; i < n; i++)
+			{
+				if (sscanf(items[i], "%ux%u", &options->width[i], &options->height[i]) != 2 ||
+					(options->width[i] < 2) || (options->height[i] < 2))
+				{
+					printf("Bad resolution : %s\n", items[i]);
+					return -1;
+				}
+			}
+			options->numRes = n;
+			break;
+		case 'p':
+			n = ParseList(optarg, items);
+			for (i = 0; i < n; i++)
+			{
+				options->format[i] = NULL;
+				for (j = 0; j < (int)(sizeof(formatList) / sizeof(formatList[0])); j++)
+				{
+					if (!strcasecmp(items[i], formatList[j].name))
+					{
+						options->format[i] = &formatList[j];
+					}
+				}
+				if (options->format[i] == NULL)
+				{
+					printf("Unknown pixel format : %s\n", items[i]);
+					return -1;
+				}
+			}
+			options->numFormats = n;
+			break;
+		case 'f':
+			n = ParseList(optarg, items);
+			for (i = 0; i < n; i++)
+			{
+				options->fps[i] = atof(items[i]);
+			}
+			options->numFps = n;
+			break;
+		case 's':
+			n = ParseList(optarg, items);
+			for (i = 0; i < n; i++)
+			{
+				for (j = 0; j < NUM_SINKS; j++)
+				{
+					if (!strcasecmp(items[i], sinkName[j]))
+					{
+						break;
+					}
+				}
+				if (j == NUM_SINKS)
+				{
+					printf("Unknown sink : %s\n", items[i]);
+					return -1;
+				}
+				options->sink[i] = (BENCH_SINK)j;
+			}
+			options->numSinks = n;
+			break;
+		case 'd':
+			options->durationMs = (unsigned int)atoi(optarg);
+			break;
+		case 'w':
+			options->warmupMs = (unsigned int)atoi(optarg);
+			break;
+		case 'n':
+			options->repeat = atoi(optarg);
+			if (options->repeat < 1)
+			{
+				printf("Bad repeat count : %s\n", optarg);
+				return -1;
+			}
+			break;
+		case 'q':
+			options->width[1] = 2048, options->height[1] = 1600;
+			options->numRes = 2;
+			options->format[1] = &formatList[2];
+			options->numFormats = 2;
+			options->fps[0] = 0;
+			options->numFps = 1;
+			options->durationMs = 300;
+			options->warmupMs = 100;
+			options->repeat = 1;
+			break;
+		case 'o':
+			options->outFile = optarg;
+			break;
+		case 'l':
+			options->label = optarg;
+			break;
+		case 'D':
+			options->recordDir = optarg;
+			break;
+		case 'k':
+			options->keepFiles = 1;
+			break;
+		case 'c':
+			options->codecMode = 1;
+			break;
+		case 't':
+			n = ParseList(optarg, items);
+			for (i = 0; i < n; i++)
+			{
+				options->codecThreads[i] = atoi(items[i]);
+				if (options->codecThreads[i] < 1)
+				{
+					printf("Bad thread count : %s\n", items[i]);
+					return -1;
+				}
+			}
+			options->numCodecThreads = n;
+			break;
+		case 'i':
+			options->codecInput = optarg;
+			options->codecMode = 1;
+			break;
+		case 'T':
+			options->selfTest = 1;
+			break;
+		default:
+			PrintUsage(argv[0]);
+			return (opt == 'h') ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	BENCH_OPTIONS options;
+	struct utsname host;
+	char date[32];
+	time_t now = time(NULL);
+	FILE *fp;
+	int r, p, f, s, n;
+	int first = 1;
+	int status;
+
+	status = ParseOptions(argc, argv, &options);
+	if (status != 0)
+	{
+		return (status > 0) ? 0 : 1;
+	}
+	if (options.selfTest)
+	{
+		logFp = stdout;
+		return (SelfTest(&options) == 0) ? 0 : 1;
+	}
+
+	fp = strcmp(options.outFile, "-") ? fopen(options.outFile, "w") : stdout;
+	logFp = (fp == stdout) ? stderr : stdout;
+	if (fp == NULL)
+	{
+		printf("Error opening %s\n", options.outFile);
+		return 1;
+	}
+
+	uname(&host);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"schema\": %d,\n", SCHEMA_VERSION);
+	fprintf(fp, "  \"label\": \"%s\",\n", options.label);
+	fprintf(fp, "  \"date\": \"%s\",\n", date);
+	fprintf(fp, "  \"host\": {\"machine\": \"%s\", \"release\": \"%s\", \"cpus\": %ld, \"compiler\": \"%s\"},\n",
+			host.machine, host.release, sysconf(_SC_NPROCESSORS_ONLN), __VERSION__);
+	fprintf(fp, "  \"duration_ms\": %u,\n", options.durationMs);
+	fprintf(fp, "  \"warmup_ms\": %u,\n", options.warmupMs);
+	fprintf(fp, "  \"repeat\": %d,\n", options.repeat);
+	fprintf(fp, "  \"scenarios\": [\n");
+
+	// One pass over the matrix per run, so slow drifts of the machine spread over all scenarios.
+	for (n = 0; (n < options.repeat) && !options.codecMode; n++)
+	{
+		for (r = 0; r < options.numRes; r++)
+		{
+			for (p = 0; p < options.numFormats; p++)
+			{
+				for (f = 0; f < options.numFps; f++)
+				{
+					for (s = 0; s < options.numSinks; s++)
+					{
+						BENCH_SCENARIO scenario;
+
+						scenario.width = options.width[r];
+						scenario.height = options.height[r];
+						scenario.format = options.format[p];
+						scenario.fps = options.fps[f];
+						scenario.sink = options.sink[s];
+						snprintf(scenario.name, sizeof(scenario.name), "%ux%u/%s/fps%g/%s", scenario.width, scenario.height,
+								 scenario.format->name, scenario.fps, sinkName[scenario.sink]);
+
+						if (RunScenario(&options, &scenario, n, fp, first) == 0)
+						{
+							first = 0;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	fprintf(fp, "\n  ],\n");
+
+	fprintf(fp, "  \"codec\": [\n");
+	first = 1;
+	if (options.codecMode)
+	{
+		int numInputs = options.codecInput ? 1 : options.numRes * options.numFormats;
+		int t;
+
+		for (n = 0; n < numInputs; n++)
+		{
+			CODEC_INPUT input;
+
+			status = options.codecInput ? LoadRecordedFrames(&input, options.codecInput)
+										: LoadSyntheticFrames(&input, options.width[n / options.numFormats],
+															  options.height[n / options.numFormats],
+															  options.format[n % options.numFormats]);
+			for (t = 0; (t < options.numCodecThreads) && (status == 0); t++)
+			{
+				if (RunCodec(&options, &input, options.codecThreads[t], fp, first) == 0)
+				{
+					first = 0;
+				}
+			}
+			FreeCodecInput(&input);
+		}
+	}
+	fprintf(fp, "\n  ]\n}\n");
+	if (fp != stdout)
+	{
+		fclose(fp);
+		printf("Results written to %s\n", options.outFile);
+	}
+	return 0;
+}
@@ -0,0 +1,29 @@
+//-----------------------------------------------------------------------------
+// cordef.h  (benchmark stub)
+//
+// Description:
+//       Minimal subset of the GigE-V base type definitions so the benchmark
+//       builds without the vendor SDK installed.
+//-----------------------------------------------------------------------------
+#ifndef _CORDEF_H_
+#define _CORDEF_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int BOOL;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef uint8_t *PUINT8;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#endif
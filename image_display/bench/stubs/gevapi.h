@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// gevapi.h  (benchmark stub)
+//
+// Description:
+//       Minimal subset of the GigE-V API used by the acquisition pipeline.
+//       The functions are implemented by the synthetic camera
+//       (synthetic_source.cpp) instead of the GigE-V library.
+//-----------------------------------------------------------------------------
+#ifndef _GEVAPI_H_
+#define _GEVAPI_H_
+
+#include "cordef.h"
+
+typedef int GEV_STATUS;
+typedef void *GEV_CAMERA_HANDLE;
+
+#define GEVLIB_OK 0
+#define GEVLIB_ERROR_TIME_OUT -2
+#define GEVLIB_ERROR_INVALID_HANDLE -3
+#define GEVLIB_ERROR_ARG_INVALID -4
+
+// Pixel formats (GenICam PFNC values).
+#define fmtMono8 0x01080001
+#define fmtMono16 0x01100007
+#define fMtBayerRG8 0x01080009
+#define fMtBayerRG16 0x0110002F
+
+typedef enum
+{
+	SynchronousNextEmpty = 0,
+	Asynchronous = 1
+} GevBufferCyclingMode;
+
+typedef struct
+{
+	UINT32 payload_type;
+	UINT32 state;
+	int status;
+	UINT32 timestamp_hi;
+	UINT32 timestamp_lo;
+	UINT64 timestamp;
+	UINT64 recv_size;
+	UINT64 id;
+	UINT32 h;
+	UINT32 w;
+	UINT32 x_offset;
+	UINT32 y_offset;
+	UINT32 x_padding;
+	UINT32 y_padding;
+	UINT32 d;
+	UINT32 format;
+	PUINT8 address;
+} GEV_BUFFER_OBJECT;
+
+GEV_STATUS GevInitializeTransfer(GEV_CAMERA_HANDLE handle, GevBufferCyclingMode mode, UINT64 bufSize, UINT32 numBuffers, UINT8 **bufAddress);
+GEV_STATUS GevFreeTransfer(GEV_CAMERA_HANDLE handle);
+GEV_STATUS GevStartTransfer(GEV_CAMERA_HANDLE handle, UINT32 numFrames);
+GEV_STATUS GevStopTransfer(GEV_CAMERA_HANDLE handle);
+GEV_STATUS GevAbortTransfer(GEV_CAMERA_HANDLE handle);
+GEV_STATUS GevWaitForNextImage(GEV_CAMERA_HANDLE handle, GEV_BUFFER_OBJECT **image_object_ptr, UINT32 timeout);
+
+int GevGetPixelDepthInBits(UINT32 pixelType);
+BOOL GevIsPixelTypeBayer(UINT32 pixelType);
+UINT32 GetPixelSizeInBytes(UINT32 pixelType);
+
+#endif
@@ -0,0 +1,455 @@
+//-----------------------------------------------------------------------------
+// synthetic_source.cpp
+//
+// Description:
+//       Synthetic camera (see synthetic_source.h).
+//-----------------------------------------------------------------------------
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include "synthetic_source.h"
+
+#define SYNTH_NUM_PATTERNS 4
+
+typedef enum
+{
+	BUF_FREE = 0,
+	BUF_FILLING,
+	BUF_FILLED,
+	BUF_HELD
+} SYNTH_BUF_STATE;
+
+typedef struct tagSYNTH_CAMERA
+{
+	SYNTH_CAMERA_CONFIG config;
+	size_t frameSize;
+	void *pattern[SYNTH_NUM_PATTERNS];
+
+	// Transfer buffers.
+	UINT32 numBuffers;
+	GEV_BUFFER_OBJECT *object;
+	SYNTH_BUF_STATE *state;
+	UINT32 *fifo; // Filled buffers, oldest first.
+	UINT32 fifoHead;
+	UINT32 fifoCount;
+	int held; // Buffer owned by the consumer (-1 if none).
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t tid;
+	int transferring;
+	long framesToSend; // -1 = continuous.
+
+	SYNTH_STATS stats;
+} SYNTH_CAMERA;
+
+UINT64 SynthTimeUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((UINT64)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static UINT64 _ThreadCpuUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ((UINT64)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+//=============================================================================
+// Pixel format helpers (PFNC : bits 16-23 hold the bits per pixel).
+
+int GevGetPixelDepthInBits(UINT32 pixelType)
+{
+	return (int)((pixelType >> 16) & 0xFF);
+}
+
+BOOL GevIsPixelTypeBayer(UINT32 pixelType)
+{
+	// PFNC Bayer GR/RG/GB/BG, 8, 10, 12 and 16 bit.
+	return ((pixelType >= 0x01080008) && (pixelType <= 0x0108000B)) ||
+		   ((pixelType >= 0x0110000C) && (pixelType <= 0x01100013)) ||
+		   ((pixelType >= 0x0110002E) && (pixelType <= 0x01100031));
+}
+
+UINT32 GetPixelSizeInBytes(UINT32 pixelType)
+{
+	return (UINT32)((GevGetPixelDepthInBits(pixelType) + 7) / 8);
+}
+
+void SynthFillPattern(void *buffer, UINT32 width, UINT32 height, UINT32 format, UINT32 seed)
+{
+	int bits = GevGetPixelDepthInBits(format);
+	UINT32 maxVal = (bits >= 16) ? 0xFFF0 : 0xFF; // (16 bit sensors are really 12 bit - keep headroom)
+	BOOL bayer = GevIsPixelTypeBayer(format);
+	UINT32 lcg = seed * 2654435761u + 1;
+	UINT32 x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			// Diagonal gradient plus a slow blob, with +/- 2% noise.
+			UINT32 v = ((x + y + seed * 16) * maxVal) / (width + height);
+			UINT32 cx = (x > width / 2) ? (x - width / 2) : (width / 2 - x);
+			UINT32 cy = (y > height / 2) ? (y - height / 2) : (height / 2 - y);
+			UINT32 noise;
+
+			if ((cx + cy) < (width + height) / 8)
+			{
+				v = (v + maxVal) / 2;
+			}
+			if (bayer)
+			{
+				// R G / G B gains.
+				static const UINT32 gain[4] = {80, 100, 100, 60};
+				v = (v * gain[((y & 1) << 1) | (x & 1)]) / 100;
+			}
+			lcg = lcg * 1664525u + 1013904223u;
+			noise = (lcg >> 16) % (maxVal / 25 + 1);
+			v = v + noise;
+			v = (v > maxVal) ? maxVal : v;
+
+			if (bits > 8)
+			{
+				((UINT16 *)buffer)[(size_t)y * width + x] = (UINT16)v;
+			}
+			else
+			{
+				((UINT8 *)buffer)[(size_t)y * width + x] = (UINT8)v;
+			}
+		}
+	}
+}
+
+//=============================================================================
+// Camera
+
+GEV_STATUS SynthOpenCamera(const SYNTH_CAMERA_CONFIG *config, GEV_CAMERA_HANDLE *handle)
+{
+	SYNTH_CAMERA *cam;
+	int i;
+
+	if ((config == NULL) || (handle == NULL) || (config->width == 0) || (config->height == 0) ||
+		(GevGetPixelDepthInBits(config->format) == 0))
+	{
+		return GEVLIB_ERROR_ARG_INVALID;
+	}
+
+	cam = (SYNTH_CAMERA *)calloc(1, sizeof(SYNTH_CAMERA));
+	if (cam == NULL)
+	{
+		return GEVLIB_ERROR_ARG_INVALID;
+	}
+	cam->config = *config;
+	cam->frameSize = (size_t)config->width * config->height * GetPixelSizeInBytes(config->format);
+	cam->held = -1;
+	pthread_mutex_init(&cam->lock, NULL);
+	pthread_cond_init(&cam->cond, NULL);
+
+	for (i = 0; i < SYNTH_NUM_PATTERNS; i++)
+	{
+		cam->pattern[i] = malloc(cam->frameSize);
+		SynthFillPattern(cam->pattern[i], config->width, config->height, config->format, (UINT32)i);
+	}
+
+	*handle = cam;
+	return GEVLIB_OK;
+}
+
+void SynthCloseCamera(GEV_CAMERA_HANDLE *handle)
+{
+	SYNTH_CAMERA *cam;
+	int i;
+
+	if ((handle == NULL) || (*handle == NULL))
+	{
+		return;
+	}
+	cam = (SYNTH_CAMERA *)*handle;
+	GevAbortTransfer(cam);
+	GevFreeTransfer(cam);
+	for (i = 0; i < SYNTH_NUM_PATTERNS; i++)
+	{
+		free(cam->pattern[i]);
+	}
+	pthread_cond_destroy(&cam->cond);
+	pthread_mutex_destroy(&cam->lock);
+	free(cam);
+	*handle = NULL;
+}
+
+void SynthGetStats(GEV_CAMERA_HANDLE handle, SYNTH_STATS *stats)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)handle;
+
+	pthread_mutex_lock(&cam->lock);
+	*stats = cam->stats;
+	pthread_mutex_unlock(&cam->lock);
+}
+
+GEV_STATUS GevInitializeTransfer(GEV_CAMERA_HANDLE handle, GevBufferCyclingMode mode, UINT64 bufSize, UINT32 numBuffers, UINT8 **bufAddress)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)handle;
+	UINT32 i;
+
+	if (cam == NULL)
+	{
+		return GEVLIB_ERROR_INVALID_HANDLE;
+	}
+	if ((mode != Asynchronous) || (numBuffers == 0) || (bufSize < cam->frameSize) || (cam->object != NULL))
+	{
+		return GEVLIB_ERROR_ARG_INVALID;
+	}
+
+	cam->numBuffers = numBuffers;
+	cam->object = (GEV_BUFFER_OBJECT *)calloc(numBuffers, sizeof(GEV_BUFFER_OBJECT));
+	cam->state = (SYNTH_BUF_STATE *)calloc(numBuffers, sizeof(SYNTH_BUF_STATE));
+	cam->fifo = (UINT32 *)calloc(numBuffers, sizeof(UINT32));
+	for (i = 0; i < numBuffers; i++)
+	{
+		cam->object[i].address = bufAddress[i];
+		cam->object[i].w = cam->config.width;
+		cam->object[i].h = cam->config.height;
+		cam->object[i].d = GetPixelSizeInBytes(cam->config.format);
+		cam->object[i].format = cam->config.format;
+		cam->object[i].recv_size = cam->frameSize;
+	}
+	return GEVLIB_OK;
+}
+
+GEV_STATUS GevFreeTransfer(GEV_CAMERA_HANDLE handle)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)handle;
+
+	if (cam == NULL)
+	{
+		return GEVLIB_ERROR_INVALID_HANDLE;
+	}
+	GevAbortTransfer(handle);
+	free(cam->object);
+	free(cam->state);
+	free(cam->fifo);
+	cam->object = NULL;
+	cam->state = NULL;
+	cam->fifo = NULL;
+	cam->numBuffers = 0;
+	return GEVLIB_OK;
+}
+
+// Get a free buffer (-1 if none). Called with the lock held.
+static int _GetFreeBuffer(SYNTH_CAMERA *cam)
+{
+	UINT32 i;
+
+	for (i = 0; i < cam->numBuffers; i++)
+	{
+		if (cam->state[i] == BUF_FREE)
+		{
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+static void *_ProducerThread(void *context)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)context;
+	UINT64 period = (cam->config.fps > 0.0) ? (UINT64)(1000000.0 / cam->config.fps) : 0;
+	UINT64 cpuStart = _ThreadCpuUs();
+	UINT64 cpuBase;
+	UINT64 frameId = 0;
+	struct timespec next;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	pthread_mutex_lock(&cam->lock);
+	cpuBase = cam->stats.cpuUs;
+	while (cam->transferring && (cam->framesToSend != 0))
+	{
+		int index = -1;
+
+		if (period != 0)
+		{
+			// Real-time : wait for the next frame time.
+			next.tv_nsec += (long)(period * 1000);
+			while (next.tv_nsec >= 1000000000L)
+			{
+				next.tv_sec++;
+				next.tv_nsec -= 1000000000L;
+			}
+			pthread_mutex_unlock(&cam->lock);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+			pthread_mutex_lock(&cam->lock);
+			if (!cam->transferring)
+			{
+				break;
+			}
+
+			index = _GetFreeBuffer(cam);
+			if (index < 0)
+			{
+				// No buffer : the frame is lost.
+				cam->stats.framesDropped++;
+				frameId++;
+				continue;
+			}
+		}
+		else
+		{
+			// Maximum rate : wait for the consumer to return a buffer.
+			while (cam->transferring && ((index = _GetFreeBuffer(cam)) < 0))
+			{
+				pthread_cond_wait(&cam->cond, &cam->lock);
+			}
+			if (!cam->transferring)
+			{
+				break;
+			}
+		}
+
+		// "Receive" the frame.
+		cam->state[index] = BUF_FILLING;
+		pthread_mutex_unlock(&cam->lock);
+		memcpy(cam->object[index].address, cam->pattern[frameId % SYNTH_NUM_PATTERNS], cam->frameSize);
+		pthread_mutex_lock(&cam->lock);
+
+		cam->object[index].id = frameId++;
+		cam->object[index].timestamp = SynthTimeUs();
+		cam->object[index].status = 0;
+		cam->state[index] = BUF_FILLED;
+		cam->fifo[(cam->fifoHead + cam->fifoCount) % cam->numBuffers] = (UINT32)index;
+		cam->fifoCount++;
+		cam->stats.framesSent++;
+		cam->stats.cpuUs = cpuBase + (_ThreadCpuUs() - cpuStart);
+		if (cam->framesToSend > 0)
+		{
+			cam->framesToSend--;
+		}
+		pthread_cond_broadcast(&cam->cond);
+	}
+	cam->stats.cpuUs = cpuBase + (_ThreadCpuUs() - cpuStart);
+	pthread_mutex_unlock(&cam->lock);
+	return NULL;
+}
+
+GEV_STATUS GevStartTransfer(GEV_CAMERA_HANDLE handle, UINT32 numFrames)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)handle;
+
+	if ((cam == NULL) || (cam->object == NULL))
+	{
+		return GEVLIB_ERROR_INVALID_HANDLE;
+	}
+	if (cam->transferring)
+	{
+		return GEVLIB_ERROR_ARG_INVALID;
+	}
+
+	cam->transferring = TRUE;
+	cam->framesToSend = (numFrames == (UINT32)-1) ? -1 : (long)numFrames;
+	if (pthread_create(&cam->tid, NULL, _ProducerThread, cam) != 0)
+	{
+		cam->transferring = FALSE;
+		return GEVLIB_ERROR_ARG_INVALID;
+	}
+	return GEVLIB_OK;
+}
+
+GEV_STATUS GevStopTransfer(GEV_CAMERA_HANDLE handle)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)handle;
+
+	if (cam == NULL)
+	{
+		return GEVLIB_ERROR_INVALID_HANDLE;
+	}
+	pthread_mutex_lock(&cam->lock);
+	if (!cam->transferring)
+	{
+		pthread_mutex_unlock(&cam->lock);
+		return GEVLIB_OK;
+	}
+	cam->transferring = FALSE;
+	pthread_cond_broadcast(&cam->cond);
+	pthread_mutex_unlock(&cam->lock);
+
+	pthread_join(cam->tid, NULL);
+	return GEVLIB_OK;
+}
+
+GEV_STATUS GevAbortTransfer(GEV_CAMERA_HANDLE handle)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)handle;
+	UINT32 i;
+
+	GevStopTransfer(handle);
+	if ((cam != NULL) && (cam->object != NULL))
+	{
+		// Discard the frames not yet delivered.
+		pthread_mutex_lock(&cam->lock);
+		for (i = 0; i < cam->numBuffers; i++)
+		{
+			cam->state[i] = BUF_FREE;
+		}
+		cam->fifoHead = 0;
+		cam->fifoCount = 0;
+		cam->held = -1;
+		pthread_mutex_unlock(&cam->lock);
+	}
+	return GEVLIB_OK;
+}
+
+GEV_STATUS GevWaitForNextImage(GEV_CAMERA_HANDLE handle, GEV_BUFFER_OBJECT **image_object_ptr, UINT32 timeout)
+{
+	SYNTH_CAMERA *cam = (SYNTH_CAMERA *)handle;
+	struct timespec deadline;
+	UINT32 index;
+
+	if ((cam == NULL) || (cam->object == NULL) || (image_object_ptr == NULL))
+	{
+		return GEVLIB_ERROR_INVALID_HANDLE;
+	}
+	*image_object_ptr = NULL;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout / 1000;
+	deadline.tv_nsec += (long)(timeout % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&cam->lock);
+
+	// The previous image goes back to the pool.
+	if (cam->held >= 0)
+	{
+		cam->state[cam->held] = BUF_FREE;
+		cam->held = -1;
+		pthread_cond_broadcast(&cam->cond);
+	}
+
+	while (cam->fifoCount == 0)
+	{
+		if (pthread_cond_timedwait(&cam->cond, &cam->lock, &deadline) == ETIMEDOUT)
+		{
+			pthread_mutex_unlock(&cam->lock);
+			return GEVLIB_ERROR_TIME_OUT;
+		}
+	}
+
+	index = cam->fifo[cam->fifoHead];
+	cam->fifoHead = (cam->fifoHead + 1) % cam->numBuffers;
+	cam->fifoCount--;
+	cam->state[index] = BUF_HELD;
+	cam->held = (int)index;
+	*image_object_ptr = &cam->object[index];
+
+	pthread_mutex_unlock(&cam->lock);
+	return GEVLIB_OK;
+}
@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// synthetic_source.h
+//
+// Description:
+//       Synthetic camera implementing the transfer part of the (stub) GigE-V
+//       API : GevInitializeTransfer / GevStartTransfer / GevWaitForNextImage...
+//
+//       A producer thread copies pre-generated frames into the transfer
+//       buffers at the configured frame rate. A buffer handed out by
+//       GevWaitForNextImage() is returned to the pool on the next call.
+//         fps > 0 : real-time camera - a frame with no free buffer is dropped.
+//         fps = 0 : the producer waits for a free buffer (maximum sustained rate).
+//
+//       The buffer timestamp is the (monotonic, us) time the frame was
+//       completely received.
+//-----------------------------------------------------------------------------
+#ifndef _SYNTHETIC_SOURCE_H_
+#define _SYNTHETIC_SOURCE_H_
+
+#include "gevapi.h"
+
+typedef struct tagSYNTH_CAMERA_CONFIG
+{
+	UINT32 width;
+	UINT32 height;
+	UINT32 format;
+	double fps;
+} SYNTH_CAMERA_CONFIG;
+
+typedef struct tagSYNTH_STATS
+{
+	UINT64 framesSent;
+	UINT64 framesDropped;
+	UINT64 cpuUs; // CPU time used by the producer thread.
+} SYNTH_STATS;
+
+GEV_STATUS SynthOpenCamera(const SYNTH_CAMERA_CONFIG *config, GEV_CAMERA_HANDLE *handle);
+void SynthCloseCamera(GEV_CAMERA_HANDLE *handle);
+void SynthGetStats(GEV_CAMERA_HANDLE handle, SYNTH_STATS *stats);
+
+// Monotonic time in microseconds (same clock as the buffer timestamps).
+UINT64 SynthTimeUs(void);
+
+// Fill a frame with a smooth gradient plus sensor-like noise.
+// (Bayer formats get a per channel gain so the mosaic looks like a real sensor.)
+void SynthFillPattern(void *buffer, UINT32 width, UINT32 height, UINT32 format, UINT32 seed);
+
+#endif
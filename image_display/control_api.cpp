@@ -0,0 +1,827 @@
+//-----------------------------------------------------------------------------
+// control_api.cpp
+//
+// Description:
+//       Command parsing, command queue and the console / batch / socket
+//       front ends of the non-interactive control interface.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "control_api.h"
+
+#define CTL_MAX_CLIENTS 8
+
+uint64_t CtlTimeUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+//=============================================================================
+// Parsing
+
+static int _ParseOnOff(const char *arg, int *val)
+{
+	if ((arg == NULL) || (arg[0] == '\0') || !strcasecmp(arg, "toggle"))
+	{
+		*val = -1;
+	}
+	else if (!strcasecmp(arg, "on") || !strcmp(arg, "1"))
+	{
+		*val = 1;
+	}
+	else if (!strcasecmp(arg, "off") || !strcmp(arg, "0"))
+	{
+		*val = 0;
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+static int _ParseLegacyKey(char key, CTL_COMMAND *cmd)
+{
+	if ((key >= '1') && (key <= '9'))
+	{
+		cmd->id = CTL_CMD_SNAP;
+		cmd->arg = key - '0';
+		return 0;
+	}
+	switch (key)
+	{
+	case 'G':
+	case 'g':
+		cmd->id = CTL_CMD_START;
+		break;
+	case 'S':
+	case 's':
+	case '0':
+		cmd->id = CTL_CMD_STOP;
+		break;
+	case 'A':
+	case 'a':
+		cmd->id = CTL_CMD_ABORT;
+		break;
+	case '@':
+		cmd->id = CTL_CMD_SAVE;
+		break;
+	case 'T':
+	case 't':
+		cmd->id = CTL_CMD_TURBO;
+		cmd->arg = -1;
+		break;
+	case '?':
+		cmd->id = CTL_CMD_HELP;
+		break;
+	case 'Q':
+	case 'q':
+	case 0x1b:
+		cmd->id = CTL_CMD_QUIT;
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+int CtlParseCommand(const char *line, CTL_COMMAND *cmd)
+{
+	char verb[32] = {0};
+	char arg1[CTL_MAX_NAME] = {0};
+	char arg2[CTL_MAX_VALUE] = {0};
+	int n;
+
+	memset(cmd, 0, sizeof(CTL_COMMAND));
+
+	// Skip leading blanks.
+	while ((*line == ' ') || (*line == '\t'))
+	{
+		line++;
+	}
+
+	n = sscanf(line, "%31s %63s %127[^\r\n]", verb, arg1, arg2);
+	if (n <= 0)
+	{
+		cmd->id = CTL_CMD_NONE;
+		return 0;
+	}
+
+	// Legacy single key commands from the original menu.
+	if ((strlen(verb) == 1) && (n == 1))
+	{
+		if (_ParseLegacyKey(verb[0], cmd) == 0)
+		{
+			return 0;
+		}
+	}
+
+	if (!strcasecmp(verb, "start") || !strcasecmp(verb, "grab"))
+	{
+		cmd->id = CTL_CMD_START;
+	}
+	else if (!strcasecmp(verb, "stop"))
+	{
+		cmd->id = CTL_CMD_STOP;
+	}
+	else if (!strcasecmp(verb, "abort"))
+	{
+		cmd->id = CTL_CMD_ABORT;
+	}
+	else if (!strcasecmp(verb, "snap"))
+	{
+		cmd->id = CTL_CMD_SNAP;
+		cmd->arg = (n > 1) ? atoi(arg1) : 1;
+		if (cmd->arg <= 0)
+		{
+			snprintf(cmd->reply, sizeof(cmd->reply), "snap : frame count must be > 0");
+			return -1;
+		}
+	}
+	else if (!strcasecmp(verb, "save"))
+	{
+		cmd->id = CTL_CMD_SAVE;
+	}
+	else if (!strcasecmp(verb, "record"))
+	{
+		cmd->id = CTL_CMD_RECORD;
+		if ((_ParseOnOff((n > 1) ? arg1 : NULL, &cmd->arg) != 0) || (cmd->arg == -1))
+		{
+			snprintf(cmd->reply, sizeof(cmd->reply), "record : expected 'on' or 'off'");
+			return -1;
+		}
+	}
+	else if (!strcasecmp(verb, "compress"))
+	{
+		cmd->id = CTL_CMD_COMPRESS;
+		if ((_ParseOnOff((n > 1) ? arg1 : NULL, &cmd->arg) != 0) || (cmd->arg == -1))
+		{
+			snprintf(cmd->reply, sizeof(cmd->reply), "compress : expected 'on' or 'off'");
+			return -1;
+		}
+	}
+	else if (!strcasecmp(verb, "turbo"))
+	{
+		cmd->id = CTL_CMD_TURBO;
+		if (_ParseOnOff((n > 1) ? arg1 : NULL, &cmd->arg) != 0)
+		{
+			snprintf(cmd->reply, sizeof(cmd->reply), "turbo : expected 'on', 'off' or 'toggle'");
+			return -1;
+		}
+	}
+	else if (!strcasecmp(verb, "set"))
+	{
+		cmd->id = CTL_CMD_SET;
+		if (n < 3)
+		{
+			snprintf(cmd->reply, sizeof(cmd->reply), "set : usage 'set <feature> <value>'");
+			return -1;
+		}
+		snprintf(cmd->name, sizeof(cmd->name), "%s", arg1);
+		snprintf(cmd->value, sizeof(cmd->value), "%s", arg2);
+	}
+	else if (!strcasecmp(verb, "get"))
+	{
+		cmd->id = CTL_CMD_GET;
+		if (n < 2)
+		{
+			snprintf(cmd->reply, sizeof(cmd->reply), "get : usage 'get <feature>'");
+			return -1;
+		}
+		snprintf(cmd->name, sizeof(cmd->name), "%s", arg1);
+	}
+	else if (!strcasecmp(verb, "stats"))
+	{
+		cmd->id = CTL_CMD_STATS;
+	}
+	else if (!strcasecmp(verb, "help"))
+	{
+		cmd->id = CTL_CMD_HELP;
+	}
+	else if (!strcasecmp(verb, "quit") || !strcasecmp(verb, "exit"))
+	{
+		cmd->id = CTL_CMD_QUIT;
+	}
+	else if (!strcasecmp(verb, "sleep"))
+	{
+		char *end = NULL;
+		long ms = 0;
+
+		cmd->id = CTL_CMD_SLEEP;
+		if (n > 1)
+		{
+			errno = 0;
+			ms = strtol(arg1, &end, 10);
+			if ((*end != '\0') || (errno != 0) || (ms < 0) || (ms > CTL_MAX_SLEEP_MS))
+			{
+				snprintf(cmd->reply, sizeof(cmd->reply), "sleep : delay must be 0 to %d ms", CTL_MAX_SLEEP_MS);
+				return -1;
+			}
+		}
+		cmd->arg = (int)ms;
+	}
+	else if (verb[0] == '#')
+	{
+		// Comment (batch scripts).
+		cmd->id = CTL_CMD_NONE;
+	}
+	else
+	{
+		snprintf(cmd->reply, sizeof(cmd->reply), "unknown command '%s' (try 'help')", verb);
+		return -1;
+	}
+	return 0;
+}
+
+void CtlPrintHelp(char *buf, size_t size)
+{
+	snprintf(buf, size,
+			 "GRAB CTL : start | stop | abort | snap <N>        (keys : [G] [S] [A] [1-9])\n"
+			 "FILES    : save | record on|off | compress on|off (keys : [@])\n"
+			 "CAMERA   : turbo [on|off|toggle] | set <feature> <value> | get <feature>  (keys : [T])\n"
+			 "MISC     : stats | sleep <ms> | help | quit       (keys : [?] [Q]or[ESC])");
+}
+
+//=============================================================================
+// Command queue
+
+void CtlQueueInit(CTL_QUEUE *queue)
+{
+	memset(queue, 0, sizeof(CTL_QUEUE));
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+}
+
+void CtlQueueShutdown(CTL_QUEUE *queue)
+{
+	CTL_COMMAND *cmd;
+
+	pthread_mutex_lock(&queue->lock);
+	queue->shutdown = 1;
+	while (queue->head != NULL)
+	{
+		cmd = queue->head;
+		queue->head = cmd->next;
+		cmd->status = -1;
+		snprintf(cmd->reply, sizeof(cmd->reply), "shutting down");
+		cmd->done = 1;
+	}
+	queue->tail = NULL;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+int CtlSubmit(CTL_QUEUE *queue, CTL_COMMAND *cmd)
+{
+	pthread_mutex_lock(&queue->lock);
+	if (queue->shutdown)
+	{
+		pthread_mutex_unlock(&queue->lock);
+		cmd->status = -1;
+		snprintf(cmd->reply, sizeof(cmd->reply), "shutting down");
+		return cmd->status;
+	}
+
+	cmd->done = 0;
+	cmd->next = NULL;
+	cmd->t_submit = CtlTimeUs();
+	if (queue->tail != NULL)
+	{
+		queue->tail->next = cmd;
+	}
+	else
+	{
+		queue->head = cmd;
+	}
+	queue->tail = cmd;
+	pthread_cond_broadcast(&queue->cond);
+
+	// Wait for the executing thread to complete it.
+	while (!cmd->done)
+	{
+		pthread_cond_wait(&queue->cond, &queue->lock);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return cmd->status;
+}
+
+CTL_COMMAND *CtlWaitCommand(CTL_QUEUE *queue, unsigned int timeout_ms)
+{
+	CTL_COMMAND *cmd = NULL;
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&queue->lock);
+	while ((queue->head == NULL) && !queue->shutdown)
+	{
+		if (pthread_cond_timedwait(&queue->cond, &queue->lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+	if (queue->head != NULL)
+	{
+		cmd = queue->head;
+		queue->head = cmd->next;
+		if (queue->head == NULL)
+		{
+			queue->tail = NULL;
+		}
+		cmd->next = NULL;
+		cmd->t_start = CtlTimeUs();
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return cmd;
+}
+
+void CtlComplete(CTL_QUEUE *queue, CTL_COMMAND *cmd)
+{
+	uint64_t wait_us;
+	uint64_t rtt_us;
+
+	pthread_mutex_lock(&queue->lock);
+	cmd->t_done = CtlTimeUs();
+	wait_us = cmd->t_start - cmd->t_submit;
+	rtt_us = cmd->t_done - cmd->t_submit;
+
+	queue->stats.count++;
+	queue->stats.wait_sum_us += wait_us;
+	queue->stats.rtt_sum_us += rtt_us;
+	if (wait_us > queue->stats.wait_max_us)
+	{
+		queue->stats.wait_max_us = wait_us;
+	}
+	if (rtt_us > queue->stats.rtt_max_us)
+	{
+		queue->stats.rtt_max_us = rtt_us;
+	}
+	if ((queue->stats.count == 1) || (rtt_us < queue->stats.rtt_min_us))
+	{
+		queue->stats.rtt_min_us = rtt_us;
+	}
+
+	cmd->done = 1;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+void CtlGetLatencyStats(CTL_QUEUE *queue, CTL_LATENCY_STATS *stats)
+{
+	pthread_mutex_lock(&queue->lock);
+	*stats = queue->stats;
+	pthread_mutex_unlock(&queue->lock);
+}
+
+int CtlExecuteLine(CTL_QUEUE *queue, const char *line, char *reply, size_t size)
+{
+	CTL_COMMAND cmd;
+	int status;
+
+	reply[0] = '\0';
+	if (CtlParseCommand(line, &cmd) != 0)
+	{
+		snprintf(reply, size, "ERR %s\n", cmd.reply);
+		return -1;
+	}
+
+	if (cmd.id == CTL_CMD_NONE)
+	{
+		return 0;
+	}
+	if (cmd.id == CTL_CMD_SLEEP)
+	{
+		struct timespec delay;
+
+		// Executed here so the application thread is never held up.
+		delay.tv_sec = cmd.arg / 1000;
+		delay.tv_nsec = (long)(cmd.arg % 1000) * 1000000;
+		while ((nanosleep(&delay, &delay) != 0) && (errno == EINTR))
+		{
+		}
+		snprintf(reply, size, "OK rtt_us=0\n");
+		return 0;
+	}
+
+	status = CtlSubmit(queue, &cmd);
+	if (status == 0)
+	{
+		if (cmd.reply[0] != '\0')
+		{
+			snprintf(reply, size, "%s\nOK rtt_us=%llu\n", cmd.reply,
+					 (unsigned long long)(cmd.t_done - cmd.t_submit));
+		}
+		else
+		{
+			snprintf(reply, size, "OK rtt_us=%llu\n", (unsigned long long)(cmd.t_done - cmd.t_submit));
+		}
+	}
+	else
+	{
+		snprintf(reply, size, "ERR %s\n", cmd.reply);
+	}
+	return status;
+}
+
+//=============================================================================
+// Console front end
+
+typedef struct tagCTL_CONSOLE
+{
+	CTL_QUEUE *queue;
+	int quit_on_eof;
+} CTL_CONSOLE;
+
+static void *_ConsoleThread(void *context)
+{
+	CTL_CONSOLE *console = (CTL_CONSOLE *)context;
+	char line[CTL_MAX_LINE];
+	char reply[CTL_MAX_REPLY + 64];
+
+	while (fgets(line, sizeof(line), stdin) != NULL)
+	{
+		CtlExecuteLine(console->queue, line, reply, sizeof(reply));
+		fputs(reply, stdout);
+		fflush(stdout);
+	}
+
+	// End of input.
+	if (console->quit_on_eof)
+	{
+		CtlExecuteLine(console->queue, "quit", reply, sizeof(reply));
+	}
+	free(console);
+	return NULL;
+}
+
+int CtlStartConsole(CTL_QUEUE *queue, int quit_on_eof)
+{
+	pthread_t tid;
+	CTL_CONSOLE *console = (CTL_CONSOLE *)malloc(sizeof(CTL_CONSOLE));
+
+	if (console == NULL)
+	{
+		return -1;
+	}
+	console->queue = queue;
+	console->quit_on_eof = quit_on_eof;
+
+	// Detached : it may stay blocked reading stdin until the process exits.
+	if (pthread_create(&tid, NULL, _ConsoleThread, console) != 0)
+	{
+		free(console);
+		return -1;
+	}
+	pthread_detach(tid);
+	return 0;
+}
+
+//=============================================================================
+// Batch front end
+
+typedef struct tagCTL_BATCH
+{
+	CTL_QUEUE *queue;
+	char *commands;
+	FILE *script;
+} CTL_BATCH;
+
+static void _BatchLine(CTL_QUEUE *queue, const char *line)
+{
+	char reply[CTL_MAX_REPLY + 64];
+
+	printf("> %s\n", line);
+	CtlExecuteLine(queue, line, reply, sizeof(reply));
+	fputs(reply, stdout);
+	fflush(stdout);
+}
+
+static void *_BatchThread(void *context)
+{
+	CTL_BATCH *batch = (CTL_BATCH *)context;
+	char line[CTL_MAX_LINE];
+	char *saveptr = NULL;
+	char *token;
+
+	// Command line commands (';' separated) first, then the script file.
+	if (batch->commands != NULL)
+	{
+		for (token = strtok_r(batch->commands, ";", &saveptr); token != NULL; token = strtok_r(NULL, ";", &saveptr))
+		{
+			_BatchLine(batch->queue, token);
+		}
+		free(batch->commands);
+	}
+	if (batch->script != NULL)
+	{
+		while (fgets(line, sizeof(line), batch->script) != NULL)
+		{
+			line[strcspn(line, "\r\n")] = '\0';
+			_BatchLine(batch->queue, line);
+		}
+		fclose(batch->script);
+	}
+
+	// Batch mode always terminates the program (no-op if the script did already).
+	_BatchLine(batch->queue, "quit");
+	free(batch);
+	return NULL;
+}
+
+int CtlStartBatch(CTL_QUEUE *queue, const char *commands, const char *script_file)
+{
+	pthread_t tid;
+	CTL_BATCH *batch = (CTL_BATCH *)calloc(1, sizeof(CTL_BATCH));
+
+	if (batch == NULL)
+	{
+		return -1;
+	}
+	batch->queue = queue;
+	if (script_file != NULL)
+	{
+		batch->script = fopen(script_file, "r");
+		if (batch->script == NULL)
+		{
+			printf("Error opening script file %s\n", script_file);
+			free(batch);
+			return -1;
+		}
+	}
+	if (commands != NULL)
+	{
+		batch->commands = strdup(commands);
+	}
+
+	if (pthread_create(&tid, NULL, _BatchThread, batch) != 0)
+	{
+		if (batch->script != NULL)
+		{
+			fclose(batch->script);
+		}
+		free(batch->commands);
+		free(batch);
+		return -1;
+	}
+	pthread_detach(tid);
+	return 0;
+}
+
+//=============================================================================
+// Unix-domain socket front end
+
+typedef struct tagCTL_CLIENT
+{
+	int fd;
+	size_t len;
+	uint64_t resume_us; // != 0 : in a "sleep" - the following lines wait until then.
+	char buf[CTL_MAX_LINE];
+} CTL_CLIENT;
+
+static void _SendAll(int fd, const char *buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			if ((n < 0) && (errno == EINTR))
+			{
+				continue;
+			}
+			return;
+		}
+		buf += n;
+		len -= (size_t)n;
+	}
+}
+
+// Execute the complete lines received so far, up to the next "sleep".
+// (A sleep only delays this client : the server thread keeps serving the others.)
+static void _RunClientLines(CTL_SERVER *server, CTL_CLIENT *client)
+{
+	char reply[CTL_MAX_REPLY + 64];
+	char *eol;
+
+	while ((client->resume_us == 0) && ((eol = strchr(client->buf, '\n')) != NULL))
+	{
+		CTL_COMMAND cmd;
+
+		*eol = '\0';
+		if ((CtlParseCommand(client->buf, &cmd) == 0) && (cmd.id == CTL_CMD_SLEEP))
+		{
+			// Replied to when it expires.
+			client->resume_us = CtlTimeUs() + (uint64_t)cmd.arg * 1000 + 1;
+		}
+		else
+		{
+			CtlExecuteLine(server->queue, client->buf, reply, sizeof(reply));
+			_SendAll(client->fd, reply, strlen(reply));
+		}
+
+		client->len -= (size_t)(eol + 1 - client->buf);
+		memmove(client->buf, eol + 1, client->len + 1);
+	}
+}
+
+// Returns -1 if the client has to be dropped.
+static int _ServeClient(CTL_SERVER *server, CTL_CLIENT *client)
+{
+	char reply[64];
+	ssize_t n;
+
+	n = recv(client->fd, client->buf + client->len, sizeof(client->buf) - 1 - client->len, 0);
+	if (n <= 0)
+	{
+		return -1;
+	}
+	client->len += (size_t)n;
+	client->buf[client->len] = '\0';
+
+	_RunClientLines(server, client);
+
+	if (client->len >= sizeof(client->buf) - 1)
+	{
+		// Line too long.
+		snprintf(reply, sizeof(reply), "ERR line too long\n");
+		_SendAll(client->fd, reply, strlen(reply));
+		return -1;
+	}
+	return 0;
+}
+
+static void *_SocketServerThread(void *context)
+{
+	CTL_SERVER *server = (CTL_SERVER *)context;
+	CTL_CLIENT clients[CTL_MAX_CLIENTS];
+	struct pollfd fds[CTL_MAX_CLIENTS + 1];
+	int numClients = 0;
+	int i;
+
+	while (!server->exit)
+	{
+		uint64_t now = CtlTimeUs();
+		int timeout_ms = 200; // Time out periodically to check for exit.
+
+		// Clients at the end of a sleep : reply and carry on with their buffered lines.
+		for (i = 0; i < numClients; i++)
+		{
+			if ((clients[i].resume_us != 0) && (clients[i].resume_us <= now))
+			{
+				clients[i].resume_us = 0;
+				_SendAll(clients[i].fd, "OK rtt_us=0\n", 12);
+				_RunClientLines(server, &clients[i]);
+			}
+		}
+
+		fds[0].fd = server->listen_fd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < numClients; i++)
+		{
+			// (A sleeping client is not read until it resumes.)
+			now = CtlTimeUs();
+			fds[i + 1].fd = (clients[i].resume_us == 0) ? clients[i].fd : -1;
+			fds[i + 1].events = POLLIN;
+			fds[i + 1].revents = 0;
+			if ((clients[i].resume_us != 0) && (clients[i].resume_us < now + (uint64_t)timeout_ms * 1000))
+			{
+				timeout_ms = (clients[i].resume_us > now) ? (int)((clients[i].resume_us - now + 999) / 1000) : 0;
+			}
+		}
+
+		if (poll(fds, numClients + 1, timeout_ms) <= 0)
+		{
+			continue;
+		}
+
+		// Serve the existing clients (iterate backwards so removal is safe).
+		for (i = numClients - 1; i >= 0; i--)
+		{
+			if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				if (_ServeClient(server, &clients[i]) != 0)
+				{
+					close(clients[i].fd);
+					clients[i] = clients[numClients - 1];
+					numClients--;
+				}
+			}
+		}
+
+		// New connection ?
+		if (fds[0].revents & POLLIN)
+		{
+			int fd = accept(server->listen_fd, NULL, NULL);
+			if (fd >= 0)
+			{
+				if (numClients < CTL_MAX_CLIENTS)
+				{
+					clients[numClients].fd = fd;
+					clients[numClients].len = 0;
+					clients[numClients].resume_us = 0;
+					clients[numClients].buf[0] = '\0';
+					numClients++;
+				}
+				else
+				{
+					_SendAll(fd, "ERR too many clients\n", 21);
+					close(fd);
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < numClients; i++)
+	{
+		close(clients[i].fd);
+	}
+	return NULL;
+}
+
+int CtlStartSocketServer(CTL_SERVER *server, CTL_QUEUE *queue, const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+
+	memset(server, 0, sizeof(CTL_SERVER));
+	server->queue = queue;
+	server->listen_fd = -1;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		printf("Control socket path too long : %s\n", path);
+		return -1;
+	}
+	strncpy(server->path, path, sizeof(server->path) - 1);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	// Only a stale socket from a previous run is removed - never another file.
+	if (lstat(path, &st) == 0)
+	{
+		if (!S_ISSOCK(st.st_mode))
+		{
+			printf("Control socket path %s exists and is not a socket\n", path);
+			return -1;
+		}
+		unlink(path);
+	}
+
+	server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server->listen_fd < 0)
+	{
+		printf("Error creating control socket : %s\n", strerror(errno));
+		return -1;
+	}
+
+	if ((bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+		(listen(server->listen_fd, 4) != 0))
+	{
+		printf("Error binding control socket %s : %s\n", path, strerror(errno));
+		close(server->listen_fd);
+		server->listen_fd = -1;
+		return -1;
+	}
+
+	if (pthread_create(&server->tid, NULL, _SocketServerThread, server) != 0)
+	{
+		close(server->listen_fd);
+		server->listen_fd = -1;
+		unlink(path);
+		return -1;
+	}
+	return 0;
+}
+
+void CtlStopSocketServer(CTL_SERVER *server)
+{
+	if (server->listen_fd >= 0)
+	{
+		server->exit = 1;
+		pthread_join(server->tid, NULL);
+		close(server->listen_fd);
+		server->listen_fd = -1;
+		unlink(server->path);
+	}
+}
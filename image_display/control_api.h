@@ -0,0 +1,127 @@
+//-----------------------------------------------------------------------------
+// control_api.h
+//
+// Description:
+//       Non-interactive command interface for the acquisition demo.
+//       Commands are plain text lines (one per line). They can come from
+//       the console, from a batch script (command line / file) or from a
+//       local Unix-domain socket. Every front end parses the line and
+//       submits it to a command queue; the application thread drains the
+//       queue and executes the commands, so nothing here ever runs in the
+//       frame receiving path.
+//
+//       This module has no dependency on the GigE-V API.
+//-----------------------------------------------------------------------------
+#ifndef _CONTROL_API_H_
+#define _CONTROL_API_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CTL_MAX_LINE 256
+#define CTL_MAX_REPLY 1024
+#define CTL_MAX_NAME 64
+#define CTL_MAX_VALUE 128
+#define CTL_MAX_SLEEP_MS 600000 // 'sleep' limit (10 minutes).
+
+typedef enum
+{
+	CTL_CMD_NONE = 0,
+	CTL_CMD_START,	// Continuous grab.
+	CTL_CMD_STOP,	// Stop grab.
+	CTL_CMD_ABORT,	// Abort grab.
+	CTL_CMD_SNAP,	// Snap N frames (arg = N).
+	CTL_CMD_SAVE,	// Save latest frame to file.
+	CTL_CMD_RECORD, // Recording on/off (arg = 1/0).
+	CTL_CMD_COMPRESS, // Compression of recorded / saved frames on/off (arg = 1/0).
+	CTL_CMD_TURBO,	// TurboMode on/off/toggle (arg = 1/0/-1).
+	CTL_CMD_SET,	// Set feature (name, value).
+	CTL_CMD_GET,	// Get feature (name).
+	CTL_CMD_STATS,	// Statistics query.
+	CTL_CMD_HELP,	// Command list.
+	CTL_CMD_QUIT,	// End program.
+	CTL_CMD_SLEEP	// Delay (arg = ms) - executed by the submitting front end.
+} CTL_CMD_ID;
+
+typedef struct tagCTL_COMMAND
+{
+	CTL_CMD_ID id;
+	int arg;
+	char name[CTL_MAX_NAME];
+	char value[CTL_MAX_VALUE];
+
+	// Filled in by the executing thread.
+	int status; // 0 = OK.
+	char reply[CTL_MAX_REPLY];
+
+	// Timestamps (us, monotonic) for round-trip latency measurement.
+	uint64_t t_submit;
+	uint64_t t_start;
+	uint64_t t_done;
+
+	int done;
+	struct tagCTL_COMMAND *next;
+} CTL_COMMAND, *PCTL_COMMAND;
+
+typedef struct tagCTL_LATENCY_STATS
+{
+	uint64_t count;
+	uint64_t wait_sum_us; // Submit -> start of execution.
+	uint64_t wait_max_us;
+	uint64_t rtt_sum_us;  // Submit -> completion.
+	uint64_t rtt_min_us;
+	uint64_t rtt_max_us;
+} CTL_LATENCY_STATS;
+
+typedef struct tagCTL_QUEUE
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	CTL_COMMAND *head;
+	CTL_COMMAND *tail;
+	int shutdown;
+	CTL_LATENCY_STATS stats;
+} CTL_QUEUE, *PCTL_QUEUE;
+
+typedef struct tagCTL_SERVER
+{
+	CTL_QUEUE *queue;
+	int listen_fd;
+	volatile int exit;
+	pthread_t tid;
+	char path[108];
+} CTL_SERVER, *PCTL_SERVER;
+
+// Monotonic time in microseconds.
+uint64_t CtlTimeUs(void);
+
+// Parse a command line. Returns 0 on success, -1 on error (with cmd->reply set).
+// Legacy single key commands ('G', '1'-'9', 'S', 'A', '@', 'T', '?', 'Q') are accepted.
+int CtlParseCommand(const char *line, CTL_COMMAND *cmd);
+void CtlPrintHelp(char *buf, size_t size);
+
+// Command queue.
+void CtlQueueInit(CTL_QUEUE *queue);
+void CtlQueueShutdown(CTL_QUEUE *queue); // Fails pending and future submissions.
+
+// Submit a command and wait for it to be executed. Returns the command status.
+int CtlSubmit(CTL_QUEUE *queue, CTL_COMMAND *cmd);
+
+// Parse and submit a line (handles "sleep" locally). Returns the command status.
+// The reply is zero or more info lines followed by a status line :
+//    "OK rtt_us=<round trip>"  or  "ERR <message>"
+int CtlExecuteLine(CTL_QUEUE *queue, const char *line, char *reply, size_t size);
+
+// Executing side : get the next command (NULL on timeout) and report its completion.
+CTL_COMMAND *CtlWaitCommand(CTL_QUEUE *queue, unsigned int timeout_ms);
+void CtlComplete(CTL_QUEUE *queue, CTL_COMMAND *cmd);
+void CtlGetLatencyStats(CTL_QUEUE *queue, CTL_LATENCY_STATS *stats);
+
+// Front ends (each runs in its own thread).
+int CtlStartConsole(CTL_QUEUE *queue, int quit_on_eof);
+int CtlStartBatch(CTL_QUEUE *queue, const char *commands, const char *script_file);
+int CtlStartSocketServer(CTL_SERVER *server, CTL_QUEUE *queue, const char *path);
+void CtlStopSocketServer(CTL_SERVER *server);
+
+#endif
@@ -0,0 +1,649 @@
+//-----------------------------------------------------------------------------
+// frame_codec.cpp
+//
+// Description:
+//       Lossless frame compression (see frame_codec.h).
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "frame_codec.h"
+
+// Longest unary prefix : larger residuals are escaped and stored verbatim.
+#define CODEC_ESCAPE 16
+#define CODEC_K_BITS 5
+// Keep bands big enough for the per band overhead to stay negligible.
+#define CODEC_MIN_BAND_ROWS 16
+
+static uint64_t _TimeUs(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+//=============================================================================
+// Bit I/O (MSB first)
+
+typedef struct tagBIT_WRITER
+{
+	uint8_t *p;
+	uint64_t acc;
+	int n; // Bits pending in acc.
+} BIT_WRITER;
+
+// len <= 32
+static inline void _PutBits(BIT_WRITER *w, uint32_t value, int len)
+{
+	w->acc = (w->acc << len) | value;
+	w->n += len;
+	if (w->n >= 32)
+	{
+		uint32_t word;
+
+		w->n -= 32;
+		word = (uint32_t)(w->acc >> w->n);
+		w->p[0] = (uint8_t)(word >> 24);
+		w->p[1] = (uint8_t)(word >> 16);
+		w->p[2] = (uint8_t)(word >> 8);
+		w->p[3] = (uint8_t)word;
+		w->p += 4;
+	}
+}
+
+static inline void _FlushBits(BIT_WRITER *w)
+{
+	while (w->n >= 8)
+	{
+		w->n -= 8;
+		*w->p++ = (uint8_t)(w->acc >> w->n);
+	}
+	if (w->n > 0)
+	{
+		*w->p++ = (uint8_t)(w->acc << (8 - w->n));
+		w->n = 0;
+	}
+}
+
+typedef struct tagBIT_READER
+{
+	const uint8_t *p;
+	const uint8_t *end;
+	uint64_t acc; // Left aligned.
+	int n;
+	int overrun; // Bytes read past the end (as zeros).
+} BIT_READER;
+
+static inline void _Refill(BIT_READER *r)
+{
+	while (r->n <= 56)
+	{
+		uint64_t byte = 0;
+
+		if (r->p < r->end)
+		{
+			byte = *r->p++;
+		}
+		else
+		{
+			r->overrun++;
+		}
+		r->acc |= byte << (56 - r->n);
+		r->n += 8;
+	}
+}
+
+// 0 < len <= 32
+static inline uint32_t _GetBits(BIT_READER *r, int len)
+{
+	uint32_t v = (uint32_t)(r->acc >> (64 - len));
+
+	r->acc <<= len;
+	r->n -= len;
+	return v;
+}
+
+//=============================================================================
+// Band coding
+
+// LOCO-I median edge detector.
+// Selects instead of branching : on noisy frames the cases are unpredictable.
+static inline int32_t _Predict(int32_t a, int32_t b, int32_t c)
+{
+	int32_t mx = (a > b) ? a : b;
+	int32_t mn = (a > b) ? b : a;
+	int32_t p = a + b - c;
+
+	p = (c >= mx) ? mn : p;
+	p = (c <= mn) ? mx : p; // (Both only when a == b == c.)
+	return p;
+}
+
+// Residual of a pixel, modulo the sample range and folded to unsigned.
+template <typename T>
+static inline uint32_t _Fold(T pixel, int32_t prediction)
+{
+	const uint32_t mask = (1u << (8 * sizeof(T))) - 1;
+	const int32_t half = 1 << (8 * sizeof(T) - 1);
+	int32_t r = (int32_t)((pixel - prediction) & mask);
+
+	r = (r >= half) ? (r - (int32_t)mask - 1) : r;
+	return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+// Inverse of _Fold().
+template <typename T>
+static inline T _Unfold(uint32_t u, int32_t prediction)
+{
+	return (T)(prediction + ((int32_t)(u >> 1) ^ -(int32_t)(u & 1)));
+}
+
+// Residuals of pixels x0..x0+n-1 of a row. up = row "step" rows above (NULL on the first
+// rows of a band). The pixels without a left neighbour (predicted from above, or mid-range)
+// and the first rows (predicted from the left) have their own loops : the main loop has
+// no per pixel edge test.
+template <typename T>
+static inline void _Residuals(const T *row, const T *up, uint32_t x0, uint32_t n, uint32_t step, uint32_t *u)
+{
+	const int32_t mid = 1 << (8 * sizeof(T) - 1);
+	uint32_t end = x0 + n;
+	uint32_t x = x0;
+
+	for (; (x < end) && (x < step); x++)
+	{
+		u[x - x0] = _Fold(row[x], (up != NULL) ? up[x] : mid);
+	}
+	if (up != NULL)
+	{
+		for (; x < end; x++)
+		{
+			u[x - x0] = _Fold(row[x], _Predict(row[x - step], up[x], up[x - step]));
+		}
+	}
+	else
+	{
+		for (; x < end; x++)
+		{
+			u[x - x0] = _Fold(row[x], row[x - step]);
+		}
+	}
+}
+
+// Inverse of _Residuals() : rebuilds pixels x0..x0+n-1 of a row.
+template <typename T>
+static inline void _Reconstruct(T *row, const T *up, uint32_t x0, uint32_t n, uint32_t step, const uint32_t *u)
+{
+	const int32_t mid = 1 << (8 * sizeof(T) - 1);
+	uint32_t end = x0 + n;
+	uint32_t x = x0;
+
+	for (; (x < end) && (x < step); x++)
+	{
+		row[x] = _Unfold<T>(u[x - x0], (up != NULL) ? up[x] : mid);
+	}
+	if (up != NULL)
+	{
+		for (; x < end; x++)
+		{
+			row[x] = _Unfold<T>(u[x - x0], _Predict(row[x - step], up[x], up[x - step]));
+		}
+	}
+	else
+	{
+		for (; x < end; x++)
+		{
+			row[x] = _Unfold<T>(u[x - x0], row[x - step]);
+		}
+	}
+}
+
+template <typename T>
+static size_t _EncodeBand(const T *src, uint32_t width, uint32_t rows, uint32_t step, uint8_t *dst)
+{
+	const int bits = 8 * sizeof(T);
+	uint32_t u[CODEC_BLOCK];
+	BIT_WRITER w = {dst, 0, 0};
+	uint32_t y, x0, i;
+
+	for (y = 0; y < rows; y++)
+	{
+		const T *row = src + (size_t)y * width;
+		const T *up = (y >= step) ? (row - (size_t)step * width) : NULL;
+
+		for (x0 = 0; x0 < width; x0 += CODEC_BLOCK)
+		{
+			uint32_t n = ((width - x0) < CODEC_BLOCK) ? (width - x0) : CODEC_BLOCK;
+			uint64_t sum = 0;
+			int k = 0;
+
+			_Residuals(row, up, x0, n, step, u);
+			for (i = 0; i < n; i++)
+			{
+				sum += u[i];
+			}
+
+			// Rice parameter ~ log2(mean residual).
+			while ((k < bits) && (((uint64_t)n << (k + 1)) <= sum))
+			{
+				k++;
+			}
+			_PutBits(&w, (uint32_t)k, CODEC_K_BITS);
+
+			for (i = 0; i < n; i++)
+			{
+				uint32_t q = u[i] >> k;
+
+				if (q < CODEC_ESCAPE)
+				{
+					// q zeros, a one, then the k low bits.
+					_PutBits(&w, (1u << k) | (u[i] & ((1u << k) - 1)), (int)q + 1 + k);
+				}
+				else
+				{
+					_PutBits(&w, 1, CODEC_ESCAPE + 1);
+					_PutBits(&w, u[i], bits);
+				}
+			}
+		}
+	}
+	_FlushBits(&w);
+	return (size_t)(w.p - dst);
+}
+
+template <typename T>
+static int _DecodeBand(const uint8_t *src, size_t size, uint32_t width, uint32_t rows, uint32_t step, T *dst)
+{
+	const int bits = 8 * sizeof(T);
+	uint32_t u[CODEC_BLOCK];
+	BIT_READER r = {src, src + size, 0, 0, 0};
+	uint32_t y, x0, i;
+
+	for (y = 0; y < rows; y++)
+	{
+		T *row = dst + (size_t)y * width;
+		const T *up = (y >= step) ? (row - (size_t)step * width) : NULL;
+
+		for (x0 = 0; x0 < width; x0 += CODEC_BLOCK)
+		{
+			uint32_t n = ((width - x0) < CODEC_BLOCK) ? (width - x0) : CODEC_BLOCK;
+			int k;
+
+			_Refill(&r);
+			k = (int)_GetBits(&r, CODEC_K_BITS);
+			if (k > bits)
+			{
+				return -1;
+			}
+
+			for (i = 0; i < n; i++)
+			{
+				int q;
+
+				_Refill(&r);
+				if (r.acc == 0)
+				{
+					return -1;
+				}
+				q = __builtin_clzll(r.acc);
+				if (q < CODEC_ESCAPE)
+				{
+					_GetBits(&r, q + 1);
+					u[i] = ((uint32_t)q << k) | ((k > 0) ? _GetBits(&r, k) : 0);
+				}
+				else
+				{
+					_GetBits(&r, CODEC_ESCAPE + 1);
+					u[i] = _GetBits(&r, bits);
+				}
+			}
+			_Reconstruct(row, up, x0, n, step, u);
+		}
+	}
+	return (r.overrun > 8) ? -1 : 0;
+}
+
+//=============================================================================
+// Thread pool
+
+static void _CodeBand(FRAME_CODEC *codec, int index)
+{
+	const CODEC_FRAME_HEADER *h = &codec->header;
+	CODEC_BAND *band = &codec->band[index];
+	uint32_t firstRow = (uint32_t)index * h->bandRows;
+	uint32_t rows = ((firstRow + h->bandRows) <= h->height) ? h->bandRows : (h->height - firstRow);
+	uint32_t step = h->bayer ? 2 : 1;
+	size_t offset = (size_t)firstRow * h->width * h->bytesPerPixel;
+
+	if (!codec->decode)
+	{
+		const uint8_t *src = (const uint8_t *)codec->src + offset;
+
+		band->size = (h->bytesPerPixel == 2) ? _EncodeBand((const uint16_t *)src, h->width, rows, step, band->buffer)
+											 : _EncodeBand(src, h->width, rows, step, band->buffer);
+		band->error = 0;
+	}
+	else
+	{
+		const uint8_t *src = (const uint8_t *)codec->src + band->offset;
+		uint8_t *dst = (uint8_t *)codec->dst + offset;
+
+		band->error = (h->bytesPerPixel == 2) ? _DecodeBand(src, band->size, h->width, rows, step, (uint16_t *)dst)
+											  : _DecodeBand(src, band->size, h->width, rows, step, dst);
+	}
+}
+
+// Take bands until there are none left. Called with the lock held; returns the CPU time used.
+static uint64_t _Work(FRAME_CODEC *codec)
+{
+	uint64_t cpu = 0;
+
+	while (codec->nextBand < (int)codec->header.numBands)
+	{
+		int index = codec->nextBand++;
+		uint64_t t0;
+
+		pthread_mutex_unlock(&codec->lock);
+		t0 = _TimeUs(CLOCK_THREAD_CPUTIME_ID);
+		_CodeBand(codec, index);
+		cpu += _TimeUs(CLOCK_THREAD_CPUTIME_ID) - t0;
+		pthread_mutex_lock(&codec->lock);
+
+		codec->bandsDone++;
+		if (codec->bandsDone == (int)codec->header.numBands)
+		{
+			pthread_cond_broadcast(&codec->doneCond);
+		}
+	}
+	return cpu;
+}
+
+static void *_WorkerThread(void *context)
+{
+	FRAME_CODEC *codec = (FRAME_CODEC *)context;
+	unsigned int jobId;
+
+	pthread_mutex_lock(&codec->lock);
+	jobId = codec->jobId;
+	while (!codec->exit)
+	{
+		// Join each job once (it may already be finished by the others).
+		if (codec->jobId != jobId)
+		{
+			jobId = codec->jobId;
+			codec->jobCpuUs += _Work(codec);
+		}
+		else
+		{
+			pthread_cond_wait(&codec->workCond, &codec->lock);
+		}
+	}
+	pthread_mutex_unlock(&codec->lock);
+	return NULL;
+}
+
+// Run a job on all threads (the caller included). Called with frameLock held.
+// The band buffers / offsets are set up by the caller (no worker touches them between jobs).
+// Returns the CPU time used by all the threads.
+static uint64_t _RunJob(FRAME_CODEC *codec, const CODEC_FRAME_HEADER *header, int decode, const void *src, void *dst)
+{
+	uint64_t cpu;
+
+	// The job is published under the lock, with a new id : a worker sees either
+	// the previous (finished) job or all of this one.
+	pthread_mutex_lock(&codec->lock);
+	codec->header = *header;
+	codec->decode = decode;
+	codec->src = src;
+	codec->dst = dst;
+	codec->nextBand = 0;
+	codec->bandsDone = 0;
+	codec->jobCpuUs = 0;
+	codec->jobId++;
+	pthread_cond_broadcast(&codec->workCond);
+
+	codec->jobCpuUs += _Work(codec);
+	while (codec->bandsDone < (int)codec->header.numBands)
+	{
+		pthread_cond_wait(&codec->doneCond, &codec->lock);
+	}
+	cpu = codec->jobCpuUs;
+	pthread_mutex_unlock(&codec->lock);
+	return cpu;
+}
+
+int CodecInit(FRAME_CODEC *codec, int numThreads)
+{
+	int i;
+
+	memset(codec, 0, sizeof(FRAME_CODEC));
+	if (numThreads <= 0)
+	{
+		numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	numThreads = (numThreads < 1) ? 1 : ((numThreads > CODEC_MAX_BANDS) ? CODEC_MAX_BANDS : numThreads);
+
+	pthread_mutex_init(&codec->frameLock, NULL);
+	pthread_mutex_init(&codec->lock, NULL);
+	pthread_cond_init(&codec->workCond, NULL);
+	pthread_cond_init(&codec->doneCond, NULL);
+
+	codec->numThreads = 1;
+	codec->tid = (pthread_t *)calloc(numThreads, sizeof(pthread_t));
+	if (codec->tid == NULL)
+	{
+		return -1;
+	}
+	for (i = 1; i < numThreads; i++)
+	{
+		if (pthread_create(&codec->tid[i], NULL, _WorkerThread, codec) != 0)
+		{
+			break;
+		}
+		codec->numThreads++;
+	}
+	return 0;
+}
+
+void CodecRelease(FRAME_CODEC *codec)
+{
+	int i;
+
+	pthread_mutex_lock(&codec->lock);
+	codec->exit = 1;
+	pthread_cond_broadcast(&codec->workCond);
+	pthread_mutex_unlock(&codec->lock);
+
+	for (i = 1; i < codec->numThreads; i++)
+	{
+		pthread_join(codec->tid[i], NULL);
+	}
+	for (i = 0; i < CODEC_MAX_BANDS; i++)
+	{
+		free(codec->band[i].buffer);
+		codec->band[i].buffer = NULL;
+	}
+	free(codec->tid);
+	codec->tid = NULL;
+	pthread_cond_destroy(&codec->doneCond);
+	pthread_cond_destroy(&codec->workCond);
+	pthread_mutex_destroy(&codec->lock);
+	pthread_mutex_destroy(&codec->frameLock);
+}
+
+// Worst case : every pixel escaped, plus the block parameters and the byte padding of a band.
+static size_t _MaxBandSize(uint32_t width, uint32_t rows, int bytesPerPixel)
+{
+	uint64_t pixels = (uint64_t)width * rows;
+	uint64_t blocks = (uint64_t)rows * ((width + CODEC_BLOCK - 1) / CODEC_BLOCK);
+
+	return (size_t)((pixels * (CODEC_ESCAPE + 1 + 8 * bytesPerPixel) + blocks * CODEC_K_BITS + 7) / 8) + 8;
+}
+
+size_t CodecMaxCompressedSize(uint32_t width, uint32_t height, int bytesPerPixel)
+{
+	return sizeof(CODEC_FRAME_HEADER) + (CODEC_MAX_BANDS * sizeof(uint32_t)) +
+		   _MaxBandSize(width, height, bytesPerPixel) + (CODEC_MAX_BANDS * 8);
+}
+
+size_t CodecCompress(FRAME_CODEC *codec, const void *src, uint32_t width, uint32_t height, int bytesPerPixel, int bayer,
+					 void *dst, size_t dstSize)
+{
+	CODEC_FRAME_HEADER header;
+	CODEC_FRAME_HEADER *h = &header;
+	uint32_t *bandSize;
+	uint8_t *out;
+	uint64_t t0;
+	uint64_t cpu;
+	size_t total;
+	uint32_t i;
+	int failed = 0;
+
+	if (((bytesPerPixel != 1) && (bytesPerPixel != 2)) || (width == 0) || (height == 0))
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&codec->frameLock);
+	t0 = _TimeUs(CLOCK_MONOTONIC);
+
+	// Bands : a couple per thread for load balancing, an even number of rows (Bayer phase).
+	memset(h, 0, sizeof(CODEC_FRAME_HEADER));
+	h->magic = CODEC_FRAME_MAGIC;
+	h->version = CODEC_VERSION;
+	h->bytesPerPixel = (uint8_t)bytesPerPixel;
+	h->bayer = bayer ? 1 : 0;
+	h->width = width;
+	h->height = height;
+	h->numBands = (uint32_t)codec->numThreads * 2;
+	h->numBands = (h->numBands > CODEC_MAX_BANDS) ? CODEC_MAX_BANDS : h->numBands;
+	h->bandRows = (height + h->numBands - 1) / h->numBands;
+	h->bandRows = (h->bandRows < CODEC_MIN_BAND_ROWS) ? CODEC_MIN_BAND_ROWS : h->bandRows;
+	h->bandRows = (h->bandRows + 1) & ~1u;
+	h->numBands = (height + h->bandRows - 1) / h->bandRows;
+
+	for (i = 0; i < h->numBands; i++)
+	{
+		size_t needed = _MaxBandSize(width, h->bandRows, bytesPerPixel);
+		CODEC_BAND *band = &codec->band[i];
+
+		if (band->capacity < needed)
+		{
+			free(band->buffer);
+			band->buffer = (uint8_t *)malloc(needed);
+			band->capacity = (band->buffer != NULL) ? needed : 0;
+		}
+		failed |= (band->buffer == NULL);
+	}
+	if (failed)
+	{
+		pthread_mutex_unlock(&codec->frameLock);
+		return 0;
+	}
+
+	cpu = _RunJob(codec, h, 0, src, NULL);
+
+	// Assemble : header, band sizes, bands.
+	total = sizeof(CODEC_FRAME_HEADER) + h->numBands * sizeof(uint32_t);
+	for (i = 0; i < h->numBands; i++)
+	{
+		total += codec->band[i].size;
+	}
+	if (total > dstSize)
+	{
+		pthread_mutex_unlock(&codec->frameLock);
+		return 0;
+	}
+
+	memcpy(dst, h, sizeof(CODEC_FRAME_HEADER));
+	bandSize = (uint32_t *)((uint8_t *)dst + sizeof(CODEC_FRAME_HEADER));
+	out = (uint8_t *)(bandSize + h->numBands);
+	for (i = 0; i < h->numBands; i++)
+	{
+		bandSize[i] = (uint32_t)codec->band[i].size;
+		memcpy(out, codec->band[i].buffer, codec->band[i].size);
+		out += codec->band[i].size;
+	}
+
+	pthread_mutex_lock(&codec->lock);
+	codec->stats.frames++;
+	codec->stats.rawBytes += (uint64_t)width * height * bytesPerPixel;
+	codec->stats.compressedBytes += total;
+	codec->stats.cpuUs += cpu;
+	codec->stats.wallUs += _TimeUs(CLOCK_MONOTONIC) - t0;
+	pthread_mutex_unlock(&codec->lock);
+
+	pthread_mutex_unlock(&codec->frameLock);
+	return total;
+}
+
+int CodecGetFrameInfo(const void *src, size_t srcSize, CODEC_FRAME_HEADER *header)
+{
+	if (srcSize < sizeof(CODEC_FRAME_HEADER))
+	{
+		return -1;
+	}
+	memcpy(header, src, sizeof(CODEC_FRAME_HEADER));
+	if ((header->magic != CODEC_FRAME_MAGIC) || (header->version != CODEC_VERSION) ||
+		((header->bytesPerPixel != 1) && (header->bytesPerPixel != 2)) || (header->numBands == 0) ||
+		(header->numBands > CODEC_MAX_BANDS) || (header->bandRows == 0) ||
+		((uint64_t)header->numBands * header->bandRows < header->height) ||
+		((uint64_t)(header->numBands - 1) * header->bandRows >= header->height))
+	{
+		return -1;
+	}
+	return 0;
+}
+
+int CodecDecompress(FRAME_CODEC *codec, const void *src, size_t srcSize, void *dst, size_t dstSize)
+{
+	CODEC_FRAME_HEADER header;
+	const uint32_t *bandSize;
+	size_t offset;
+	uint32_t i;
+	int status = 0;
+
+	if ((CodecGetFrameInfo(src, srcSize, &header) != 0) ||
+		((uint64_t)header.width * header.height * header.bytesPerPixel > dstSize))
+	{
+		return -1;
+	}
+
+	// Locate the bands.
+	offset = sizeof(CODEC_FRAME_HEADER) + header.numBands * sizeof(uint32_t);
+	if (offset > srcSize)
+	{
+		return -1;
+	}
+	bandSize = (const uint32_t *)((const uint8_t *)src + sizeof(CODEC_FRAME_HEADER));
+
+	pthread_mutex_lock(&codec->frameLock);
+	for (i = 0; i < header.numBands; i++)
+	{
+		if (bandSize[i] > srcSize - offset)
+		{
+			pthread_mutex_unlock(&codec->frameLock);
+			return -1;
+		}
+		codec->band[i].offset = offset;
+		codec->band[i].size = bandSize[i];
+		offset += bandSize[i];
+	}
+
+	_RunJob(codec, &header, 1, src, dst);
+
+	for (i = 0; i < header.numBands; i++)
+	{
+		status |= codec->band[i].error;
+	}
+	pthread_mutex_unlock(&codec->frameLock);
+	return status ? -1 : 0;
+}
+
+void CodecGetStats(FRAME_CODEC *codec, CODEC_STATS *stats)
+{
+	pthread_mutex_lock(&codec->lock);
+	*stats = codec->stats;
+	pthread_mutex_unlock(&codec->lock);
+}
@@ -0,0 +1,109 @@
+//-----------------------------------------------------------------------------
+// frame_codec.h
+//
+// Description:
+//       Lossless frame compression for recording and saving.
+//
+//       Each pixel is predicted from its neighbours of the same colour
+//       (2 pixels apart for Bayer mosaics, 1 for monochrome) with the LOCO-I
+//       median edge detector, and the residual is Rice coded with a
+//       parameter chosen per block of CODEC_BLOCK pixels.
+//       The frame is cut into bands of rows coded independently, so bands are
+//       compressed / decompressed in parallel by a small thread pool.
+//
+//       8 and 16 bit samples (1 or 2 bytes per pixel) are supported.
+//
+//       Compressed frame layout :
+//          CODEC_FRAME_HEADER, uint32_t bandSize[numBands], band data...
+//
+//       This module has no dependency on the GigE-V API.
+//-----------------------------------------------------------------------------
+#ifndef _FRAME_CODEC_H_
+#define _FRAME_CODEC_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CODEC_FRAME_MAGIC 0x46435647 // "GVCF"
+#define CODEC_VERSION 1
+#define CODEC_MAX_BANDS 64
+#define CODEC_BLOCK 32
+
+typedef struct tagCODEC_FRAME_HEADER
+{
+	uint32_t magic;
+	uint16_t version;
+	uint8_t bytesPerPixel;
+	uint8_t bayer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t numBands;
+	uint32_t bandRows; // Rows per band (the last band gets the remainder).
+} CODEC_FRAME_HEADER;
+
+typedef struct tagCODEC_STATS
+{
+	uint64_t frames;
+	uint64_t rawBytes;
+	uint64_t compressedBytes;
+	uint64_t cpuUs;	 // CPU time spent compressing, all threads.
+	uint64_t wallUs; // Elapsed compression time.
+} CODEC_STATS;
+
+typedef struct tagCODEC_BAND
+{
+	uint8_t *buffer; // Compressed band (encoder scratch).
+	size_t capacity;
+	size_t size;
+	size_t offset; // Decoder : offset of the band in the source.
+	int error;
+} CODEC_BAND;
+
+typedef struct tagFRAME_CODEC
+{
+	int numThreads; // Including the calling thread.
+	pthread_t *tid;
+
+	// Serializes frames (the recorder and 'save' may share a codec).
+	pthread_mutex_t frameLock;
+
+	// Current job (published by _RunJob() under lock).
+	pthread_mutex_t lock;
+	pthread_cond_t workCond;
+	pthread_cond_t doneCond;
+	unsigned int jobId; // Incremented for every job : workers wait for a new id.
+	int decode;
+	const void *src;
+	void *dst;
+	CODEC_FRAME_HEADER header;
+	CODEC_BAND band[CODEC_MAX_BANDS];
+	int nextBand;
+	int bandsDone;
+	uint64_t jobCpuUs;
+	int exit;
+
+	CODEC_STATS stats;
+} FRAME_CODEC, *PFRAME_CODEC;
+
+// numThreads = 0 : one per online CPU. Returns 0 on success.
+int CodecInit(FRAME_CODEC *codec, int numThreads);
+void CodecRelease(FRAME_CODEC *codec);
+
+// Largest possible compressed size of a frame.
+size_t CodecMaxCompressedSize(uint32_t width, uint32_t height, int bytesPerPixel);
+
+// Returns the compressed size, or 0 if the frame can't be compressed
+// (unsupported pixel size or dst too small).
+size_t CodecCompress(FRAME_CODEC *codec, const void *src, uint32_t width, uint32_t height, int bytesPerPixel, int bayer,
+					 void *dst, size_t dstSize);
+
+// Returns 0 on success, -1 if the data is corrupt or dst is too small.
+int CodecDecompress(FRAME_CODEC *codec, const void *src, size_t srcSize, void *dst, size_t dstSize);
+
+// Reads the frame header of compressed data. Returns 0 on success.
+int CodecGetFrameInfo(const void *src, size_t srcSize, CODEC_FRAME_HEADER *header);
+
+void CodecGetStats(FRAME_CODEC *codec, CODEC_STATS *stats);
+
+#endif
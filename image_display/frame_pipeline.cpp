@@ -0,0 +1,79 @@
+//-----------------------------------------------------------------------------
+// frame_pipeline.cpp
+//
+// Description:
+//       Frame receive loop (see frame_pipeline.h).
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include <time.h>
+#include "frame_pipeline.h"
+
+static uint64_t _TimeUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+void PipelineInit(FRAME_PIPELINE *pipeline)
+{
+	memset(pipeline, 0, sizeof(FRAME_PIPELINE));
+	pipeline->timeoutMs = 1000;
+}
+
+void *PipelineThread(void *context)
+{
+	FRAME_PIPELINE *pipeline = (FRAME_PIPELINE *)context;
+
+	// While we are still running.
+	while (!pipeline->exit)
+	{
+		GEV_BUFFER_OBJECT *img = NULL;
+		GEV_STATUS status = 0;
+
+		// Wait for images to be received.
+		// (Returns at once with the oldest unread frame if there is one.)
+		status = GevWaitForNextImage(pipeline->camHandle, &img, pipeline->timeoutMs);
+
+		if ((img != NULL) && (status == GEVLIB_OK))
+		{
+			if (img->status == 0)
+			{
+				uint64_t t_start = _TimeUs();
+
+				pipeline->frames++;
+				pipeline->latestBuffer = img->address;
+
+				// Hand the frame to the recorder (copies it or drops it - never waits for the disk).
+				if ((pipeline->recorder != NULL) && RecorderIsActive(pipeline->recorder))
+				{
+					RecorderOfferFrame(pipeline->recorder, img->address,
+									   (size_t)img->w * img->h * GetPixelSizeInBytes(img->format),
+									   (uint32_t)img->id, (uint64_t)img->timestamp, img->w, img->h, img->format);
+				}
+
+				if (pipeline->display != NULL)
+				{
+					pipeline->display(img, pipeline->context);
+				}
+
+				if (pipeline->frameDone != NULL)
+				{
+					pipeline->frameDone(img, t_start, _TimeUs(), pipeline->context);
+				}
+			}
+			else
+			{
+				// Image had an error (incomplete (timeout/overflow/lost)).
+				// Do any handling of this condition necessary.
+				pipeline->errors++;
+			}
+		}
+		else
+		{
+			pipeline->timeouts++;
+		}
+	}
+	return NULL;
+}
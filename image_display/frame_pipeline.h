@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+// frame_pipeline.h
+//
+// Description:
+//       Frame receive loop, shared by image_display and the benchmark
+//       (bench/image_bench).
+//       PipelineThread() waits for frames from the GigE-V API and hands every
+//       good frame to the recorder (copied or dropped - never waits for the
+//       disk) and then to the display sink.
+//       The display sink is a callback : image_display converts and shows the
+//       frame with the SDK display utilities, the benchmark plugs in its own
+//       conversion (the SDK common code is not part of that build).
+//-----------------------------------------------------------------------------
+#ifndef _FRAME_PIPELINE_H_
+#define _FRAME_PIPELINE_H_
+
+#include <stdint.h>
+#include "cordef.h"
+#include "gevapi.h"
+#include "frame_recorder.h"
+
+// Display sink (called from the pipeline thread).
+typedef void (*PIPELINE_SINK)(GEV_BUFFER_OBJECT *img, void *context);
+
+// Called after the sinks with the time they started / finished (monotonic clock, us).
+typedef void (*PIPELINE_FRAME_DONE)(GEV_BUFFER_OBJECT *img, uint64_t t_start_us, uint64_t t_done_us, void *context);
+
+typedef struct tagFRAME_PIPELINE
+{
+	GEV_CAMERA_HANDLE camHandle;
+	UINT32 timeoutMs;			   // Wait for a frame (also the reaction time to 'exit').
+	FRAME_RECORDER *recorder;	   // NULL : no recording.
+	PIPELINE_SINK display;		   // NULL : no display.
+	PIPELINE_FRAME_DONE frameDone; // NULL : no per frame notification.
+	void *context;				   // Passed to the callbacks.
+	volatile BOOL exit;
+
+	// Written by the pipeline thread only.
+	void *volatile latestBuffer; // Last good frame.
+	volatile unsigned long frames;
+	volatile unsigned long errors;
+	volatile unsigned long timeouts;
+} FRAME_PIPELINE, *PFRAME_PIPELINE;
+
+// Clears the statistics (the caller fills in the handle, sinks and timeout).
+void PipelineInit(FRAME_PIPELINE *pipeline);
+
+// Thread function (context = FRAME_PIPELINE *), runs until pipeline->exit is set.
+void *PipelineThread(void *context);
+
+#endif
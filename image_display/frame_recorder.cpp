@@ -0,0 +1,372 @@
+//-----------------------------------------------------------------------------
+// frame_recorder.cpp
+//
+// Description:
+//       Frame recording (see frame_recorder.h).
+//-----------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+#include "frame_recorder.h"
+
+// Compress a frame if possible : updates header (encoding / size) and returns the payload to write.
+// (*buffer / *capacity : compression buffer, grown as needed.)
+static const void *_CompressFrame(FRAME_CODEC *codec, int bytesPerPixel, int bayer, RECORD_FRAME_HEADER *header,
+								  const void *data, void **buffer, size_t *capacity)
+{
+	header->encoding = RECORD_ENCODING_RAW;
+	header->size = header->rawSize;
+
+	if ((codec != NULL) && ((size_t)header->width * header->height * bytesPerPixel == header->rawSize))
+	{
+		size_t needed = CodecMaxCompressedSize(header->width, header->height, bytesPerPixel);
+		size_t size;
+
+		if (*capacity < needed)
+		{
+			free(*buffer);
+			*buffer = malloc(needed);
+			*capacity = (*buffer != NULL) ? needed : 0;
+		}
+		if (*buffer != NULL)
+		{
+			size = CodecCompress(codec, data, header->width, header->height, bytesPerPixel, bayer, *buffer, *capacity);
+			// Keep the raw frame if it doesn't compress.
+			if ((size > 0) && (size < header->rawSize))
+			{
+				header->encoding = RECORD_ENCODING_CODEC;
+				header->size = (uint32_t)size;
+				return *buffer;
+			}
+		}
+	}
+	return data;
+}
+
+// Write one frame (header + payload). Returns the bytes written or -1.
+static long _WriteFrame(FILE *fp, const RECORD_FRAME_HEADER *header, const void *payload)
+{
+	if ((fwrite(header, sizeof(RECORD_FRAME_HEADER), 1, fp) != 1) ||
+		(fwrite(payload, 1, header->size, fp) != header->size))
+	{
+		return -1;
+	}
+	return (long)(sizeof(RECORD_FRAME_HEADER) + header->size);
+}
+
+// Compression stage (only with a codec) : FULL slots -> READY.
+static void *_CompressThread(void *context)
+{
+	FRAME_RECORDER *rec = (FRAME_RECORDER *)context;
+
+	pthread_mutex_lock(&rec->lock);
+	while (1)
+	{
+		RECORD_SLOT *slot = &rec->slot[rec->cp];
+
+		// Wait for data (keep going until the ring is drained on exit).
+		while ((slot->state != RECORD_SLOT_FULL) && !rec->exit)
+		{
+			pthread_cond_wait(&rec->cond, &rec->lock);
+		}
+		if (slot->state != RECORD_SLOT_FULL)
+		{
+			break;
+		}
+
+		// The slot belongs to this thread until it is marked READY.
+		pthread_mutex_unlock(&rec->lock);
+		slot->payload = _CompressFrame(rec->codec, rec->bytesPerPixel, rec->bayer, &slot->header, slot->buffer,
+									   &slot->compressBuffer, &slot->compressCapacity);
+		pthread_mutex_lock(&rec->lock);
+
+		slot->state = RECORD_SLOT_READY;
+		rec->cp = (rec->cp + 1) % RECORD_NUM_SLOTS;
+		pthread_cond_broadcast(&rec->cond);
+	}
+	pthread_mutex_unlock(&rec->lock);
+	return NULL;
+}
+
+// Write stage : READY slots -> disk -> EMPTY.
+static void *_RecorderThread(void *context)
+{
+	FRAME_RECORDER *rec = (FRAME_RECORDER *)context;
+
+	pthread_mutex_lock(&rec->lock);
+	while (1)
+	{
+		RECORD_SLOT *slot = &rec->slot[rec->rd];
+
+		// Wait for data (keep going until the ring is drained on exit).
+		while ((slot->state != RECORD_SLOT_READY) && !rec->writerExit)
+		{
+			pthread_cond_wait(&rec->cond, &rec->lock);
+		}
+		if (slot->state != RECORD_SLOT_READY)
+		{
+			break;
+		}
+
+		// The slot belongs to this thread until it is marked empty :
+		// write it without holding the lock.
+		pthread_mutex_unlock(&rec->lock);
+		long written = _WriteFrame(rec->fp, &slot->header, slot->payload);
+		pthread_mutex_lock(&rec->lock);
+
+		if (written > 0)
+		{
+			rec->framesWritten++;
+			rec->bytesWritten += (uint64_t)written;
+			rec->rawBytes += sizeof(RECORD_FRAME_HEADER) + slot->header.rawSize;
+		}
+		else
+		{
+			rec->writeError = 1;
+		}
+		slot->state = RECORD_SLOT_EMPTY;
+		rec->rd = (rec->rd + 1) % RECORD_NUM_SLOTS;
+	}
+	pthread_mutex_unlock(&rec->lock);
+	return NULL;
+}
+
+void RecorderInit(FRAME_RECORDER *rec)
+{
+	memset(rec, 0, sizeof(FRAME_RECORDER));
+	pthread_mutex_init(&rec->lock, NULL);
+	pthread_cond_init(&rec->cond, NULL);
+}
+
+int RecorderSetCodec(FRAME_RECORDER *rec, FRAME_CODEC *codec, int bytesPerPixel, int bayer)
+{
+	pthread_mutex_lock(&rec->lock);
+	if (rec->active)
+	{
+		pthread_mutex_unlock(&rec->lock);
+		return -1;
+	}
+	rec->codec = codec;
+	rec->bytesPerPixel = bytesPerPixel;
+	rec->bayer = bayer;
+	pthread_mutex_unlock(&rec->lock);
+	return 0;
+}
+
+static void _FreeSlots(FRAME_RECORDER *rec)
+{
+	int i;
+
+	for (i = 0; i < RECORD_NUM_SLOTS; i++)
+	{
+		free(rec->slot[i].buffer);
+		rec->slot[i].buffer = NULL;
+		free(rec->slot[i].compressBuffer);
+		rec->slot[i].compressBuffer = NULL;
+		rec->slot[i].compressCapacity = 0;
+	}
+}
+
+int RecorderStart(FRAME_RECORDER *rec, const char *filename, size_t maxFrameSize)
+{
+	int i;
+
+	if (rec->active)
+	{
+		return -1;
+	}
+
+	rec->fp = fopen(filename, "wb");
+	if (rec->fp == NULL)
+	{
+		return -1;
+	}
+	strncpy(rec->filename, filename, sizeof(rec->filename) - 1);
+
+	for (i = 0; i < RECORD_NUM_SLOTS; i++)
+	{
+		rec->slot[i].buffer = malloc(maxFrameSize);
+		rec->slot[i].state = RECORD_SLOT_EMPTY;
+		if (rec->slot[i].buffer == NULL)
+		{
+			_FreeSlots(rec);
+			fclose(rec->fp);
+			rec->fp = NULL;
+			return -1;
+		}
+	}
+
+	rec->maxFrameSize = maxFrameSize;
+	rec->wr = 0;
+	rec->cp = 0;
+	rec->rd = 0;
+	rec->exit = 0;
+	rec->writerExit = 0;
+	rec->framesWritten = 0;
+	rec->framesDropped = 0;
+	rec->bytesWritten = 0;
+	rec->rawBytes = 0;
+	rec->writeError = 0;
+
+	if (pthread_create(&rec->tid, NULL, _RecorderThread, rec) != 0)
+	{
+		_FreeSlots(rec);
+		fclose(rec->fp);
+		rec->fp = NULL;
+		return -1;
+	}
+	if ((rec->codec != NULL) && (pthread_create(&rec->compressTid, NULL, _CompressThread, rec) != 0))
+	{
+		pthread_mutex_lock(&rec->lock);
+		rec->writerExit = 1;
+		pthread_cond_broadcast(&rec->cond);
+		pthread_mutex_unlock(&rec->lock);
+		pthread_join(rec->tid, NULL);
+
+		_FreeSlots(rec);
+		fclose(rec->fp);
+		rec->fp = NULL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&rec->lock);
+	rec->active = 1;
+	pthread_mutex_unlock(&rec->lock);
+	return 0;
+}
+
+void RecorderStop(FRAME_RECORDER *rec)
+{
+	pthread_mutex_lock(&rec->lock);
+	if (!rec->active)
+	{
+		pthread_mutex_unlock(&rec->lock);
+		return;
+	}
+	// No more frames accepted - the threads drain what is already queued :
+	// first the compression stage, then the writer.
+	rec->active = 0;
+	rec->exit = 1;
+	pthread_cond_broadcast(&rec->cond);
+	pthread_mutex_unlock(&rec->lock);
+
+	if (rec->codec != NULL)
+	{
+		pthread_join(rec->compressTid, NULL);
+	}
+
+	pthread_mutex_lock(&rec->lock);
+	rec->writerExit = 1;
+	pthread_cond_broadcast(&rec->cond);
+	pthread_mutex_unlock(&rec->lock);
+	pthread_join(rec->tid, NULL);
+
+	// The last frames reach the file here.
+	if (fclose(rec->fp) != 0)
+	{
+		pthread_mutex_lock(&rec->lock);
+		rec->writeError = 1;
+		pthread_mutex_unlock(&rec->lock);
+	}
+	rec->fp = NULL;
+	_FreeSlots(rec);
+}
+
+int RecorderIsActive(FRAME_RECORDER *rec)
+{
+	int active;
+
+	pthread_mutex_lock(&rec->lock);
+	active = rec->active;
+	pthread_mutex_unlock(&rec->lock);
+	return active;
+}
+
+int RecorderOfferFrame(FRAME_RECORDER *rec, const void *data, size_t size, uint32_t id, uint64_t timestamp,
+					   uint32_t width, uint32_t height, uint32_t format)
+{
+	RECORD_SLOT *slot;
+
+	pthread_mutex_lock(&rec->lock);
+	if (!rec->active)
+	{
+		pthread_mutex_unlock(&rec->lock);
+		return -1;
+	}
+
+	slot = &rec->slot[rec->wr];
+	if ((slot->state != RECORD_SLOT_EMPTY) || (size > rec->maxFrameSize))
+	{
+		// Compression / writing is behind (or bad frame) - drop rather than wait.
+		rec->framesDropped++;
+		pthread_mutex_unlock(&rec->lock);
+		return -1;
+	}
+
+	// (The copy is done under the lock so RecorderStop() can't free the slot underneath it.
+	//  The recorder threads never hold the lock while compressing / writing.)
+	memcpy(slot->buffer, data, size);
+	slot->header.magic = RECORD_FRAME_MAGIC;
+	slot->header.id = id;
+	slot->header.timestamp = timestamp;
+	slot->header.width = width;
+	slot->header.height = height;
+	slot->header.format = format;
+	slot->header.encoding = RECORD_ENCODING_RAW;
+	slot->header.rawSize = (uint32_t)size;
+	slot->header.size = (uint32_t)size;
+	slot->payload = slot->buffer;
+	// Straight to the writer without a codec.
+	slot->state = (rec->codec != NULL) ? RECORD_SLOT_FULL : RECORD_SLOT_READY;
+	rec->wr = (rec->wr + 1) % RECORD_NUM_SLOTS;
+
+	pthread_cond_broadcast(&rec->cond);
+	pthread_mutex_unlock(&rec->lock);
+	return 0;
+}
+
+void RecorderGetStats(FRAME_RECORDER *rec, RECORD_STATS *stats)
+{
+	pthread_mutex_lock(&rec->lock);
+	stats->active = rec->active;
+	stats->framesWritten = rec->framesWritten;
+	stats->framesDropped = rec->framesDropped;
+	stats->bytesWritten = rec->bytesWritten;
+	stats->rawBytes = rec->rawBytes;
+	stats->writeError = rec->writeError;
+	pthread_mutex_unlock(&rec->lock);
+}
+
+long RecorderSaveFrame(const char *filename, FRAME_CODEC *codec, int bytesPerPixel, int bayer, const void *data,
+					   size_t size, uint32_t id, uint64_t timestamp, uint32_t width, uint32_t height, uint32_t format)
+{
+	RECORD_FRAME_HEADER header;
+	const void *payload;
+	void *buffer = NULL;
+	size_t capacity = 0;
+	long written;
+	FILE *fp;
+
+	fp = fopen(filename, "wb");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = RECORD_FRAME_MAGIC;
+	header.id = id;
+	header.timestamp = timestamp;
+	header.width = width;
+	header.height = height;
+	header.format = format;
+	header.rawSize = (uint32_t)size;
+	payload = _CompressFrame(codec, bytesPerPixel, bayer, &header, data, &buffer, &capacity);
+	written = _WriteFrame(fp, &header, payload);
+
+	free(buffer);
+	if (fclose(fp) != 0)
+	{
+		written = -1;
+	}
+	return written;
+}
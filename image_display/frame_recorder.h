@@ -0,0 +1,126 @@
+//-----------------------------------------------------------------------------
+// frame_recorder.h
+//
+// Description:
+//       Frame recording to a single file.
+//       The receiving thread offers frames with RecorderOfferFrame() which only
+//       copies the frame into a free slot of a small ring (or counts a drop if
+//       the writer is behind). A dedicated thread writes the slots to disk.
+//       If a codec is set (RecorderSetCodec()) a second thread compresses the
+//       slots ahead of the writer, so compression and disk writes overlap.
+//
+//       File layout : a sequence of (RECORD_FRAME_HEADER, frame data).
+//       The frame data is raw or a compressed frame (see frame_codec.h)
+//       depending on the header encoding. Frames that don't compress are
+//       stored raw.
+//
+//       This module has no dependency on the GigE-V API.
+//-----------------------------------------------------------------------------
+#ifndef _FRAME_RECORDER_H_
+#define _FRAME_RECORDER_H_
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "frame_codec.h"
+
+#define RECORD_NUM_SLOTS 8
+#define RECORD_FRAME_MAGIC 0x32525647	 // "GVR2"
+#define RECORD_FRAME_MAGIC_V1 0x46525647 // "GVRF" : first format (no encoding / rawSize) - not readable.
+
+#define RECORD_ENCODING_RAW 0
+#define RECORD_ENCODING_CODEC 1
+
+typedef struct tagRECORD_FRAME_HEADER
+{
+	uint32_t magic;
+	uint32_t id;
+	uint64_t timestamp;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t encoding; // RECORD_ENCODING_xxx
+	uint32_t rawSize;  // Bytes of the uncompressed frame.
+	uint32_t size;	   // Bytes of frame data following the header.
+} RECORD_FRAME_HEADER;
+
+// Slot life cycle : EMPTY -> FULL (frame copied) -> [compressed] -> READY -> written -> EMPTY.
+#define RECORD_SLOT_EMPTY 0
+#define RECORD_SLOT_FULL 1
+#define RECORD_SLOT_READY 2
+
+typedef struct tagRECORD_SLOT
+{
+	void *buffer;
+	RECORD_FRAME_HEADER header; // Describes the payload once READY.
+	const void *payload;		// buffer, or compressBuffer.
+	void *compressBuffer;
+	size_t compressCapacity;
+	int state; // RECORD_SLOT_xxx
+} RECORD_SLOT;
+
+typedef struct tagFRAME_RECORDER
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t tid;
+	pthread_t compressTid;
+	FILE *fp;
+	char filename[256];
+	size_t maxFrameSize;
+	RECORD_SLOT slot[RECORD_NUM_SLOTS];
+
+	// Compression (codec = NULL : raw).
+	FRAME_CODEC *codec;
+	int bytesPerPixel;
+	int bayer;
+
+	int wr; // Next slot to fill (frame path).
+	int cp; // Next slot to compress.
+	int rd; // Next slot to write.
+	int active;
+	int exit;		 // Stop the compression thread (after draining).
+	int writerExit; // Stop the writer thread (after draining).
+
+	// Statistics.
+	uint64_t framesWritten;
+	uint64_t framesDropped;
+	uint64_t bytesWritten;
+	uint64_t rawBytes; // Frame bytes before compression.
+	int writeError;
+} FRAME_RECORDER, *PFRAME_RECORDER;
+
+typedef struct tagRECORD_STATS
+{
+	int active;
+	uint64_t framesWritten;
+	uint64_t framesDropped;
+	uint64_t bytesWritten;
+	uint64_t rawBytes;
+	int writeError;
+} RECORD_STATS;
+
+// One time initialization (the recorder starts inactive).
+void RecorderInit(FRAME_RECORDER *rec);
+// Compress the recorded frames (codec = NULL for raw recording). Only while not recording.
+// (The pixel layout is fixed for a recording : 1 or 2 bytes per pixel, Bayer mosaic or not.)
+int RecorderSetCodec(FRAME_RECORDER *rec, FRAME_CODEC *codec, int bytesPerPixel, int bayer);
+// Open the file and start the writer (and compression) thread. Returns 0 on success.
+int RecorderStart(FRAME_RECORDER *rec, const char *filename, size_t maxFrameSize);
+// Flush pending frames, stop the threads and close the file.
+void RecorderStop(FRAME_RECORDER *rec);
+int RecorderIsActive(FRAME_RECORDER *rec);
+
+// Called from the frame path. Never waits for the disk.
+// Returns 0 if the frame was queued, -1 if it was dropped.
+int RecorderOfferFrame(FRAME_RECORDER *rec, const void *data, size_t size, uint32_t id, uint64_t timestamp,
+					   uint32_t width, uint32_t height, uint32_t format);
+
+void RecorderGetStats(FRAME_RECORDER *rec, RECORD_STATS *stats);
+
+// Write a single frame file in the recording format (compressed if codec != NULL).
+// Returns the number of bytes written, or -1 on error.
+long RecorderSaveFrame(const char *filename, FRAME_CODEC *codec, int bytesPerPixel, int bayer, const void *data,
+					   size_t size, uint32_t id, uint64_t timestamp, uint32_t width, uint32_t height, uint32_t format);
+
+#endif
@@ -7,7 +7,12 @@
 #include "X_Display_utils.h"
 #include "FileUtil.h"
 #include <sched.h>
+#include <unistd.h>
 #include <iostream> // [R] Added for debug purpose
+#include "control_api.h"
+#include "frame_recorder.h"
+#include "frame_codec.h"
+#include "frame_pipeline.h"
 
 #define DISPLAY 1
 
@@ -29,17 +34,13 @@
 
 #define LOG(x) std::cout << x << std::endl
 
-void *m_latestBuffer = NULL;
-
 typedef struct tagMY_CONTEXT
 {
 	X_VIEW_HANDLE View;
-	GEV_CAMERA_HANDLE camHandle;
 	int depth;
 	int format;
 	void *convertBuffer;
 	BOOL convertFormat;
-	BOOL exit;
 } MY_CONTEXT, *PMY_CONTEXT;
 
 static unsigned long us_timer_init(void)
@@ -112,20 +113,21 @@ static void _GetUniqueFilename(char *filename, size_t size, char *basename)
 	}
 }
 
-char GetKey()
+void PrintMenu()
 {
-	char key = getchar();
-	while ((key == '\r') || (key == '\n'))
-	{
-		key = getchar();
-	}
-	return key;
+	char help[CTL_MAX_REPLY];
+
+	CtlPrintHelp(help, sizeof(help));
+	printf("%s\n", help);
 }
 
-void PrintMenu()
+void PrintUsage(const char *prog)
 {
-	printf("GRAB CTL : [S]=stop, [1-9]=snap N, [G]=continuous, [A]=Abort\n");
-	printf("MISC     : [Q]or[ESC]=end,         [T]=Toggle TurboMode (if available), [@]=SaveToFile\n");
+	printf("Usage : %s [-c \"cmd;cmd;...\"] [-f script] [-s socket] [camera_index]\n", prog);
+	printf("   -c : batch mode - run the ';' separated commands then quit\n");
+	printf("   -f : batch mode - run the commands from a script file (one per line) then quit\n");
+	printf("   -s : accept commands on a local Unix-domain socket (e.g. 'nc -U <socket>')\n");
+	printf("(Without -c/-f commands are read from the console.)\n");
 }
 
 void print_buffer_data_info(GEV_BUFFER_OBJECT *img)
@@ -155,73 +157,38 @@ void print_buffer_data_info(GEV_BUFFER_OBJECT *img)
 	// std::cout << "---------------------------------" << std::endl;
 }
 
-void *ImageDisplayThread(void *context)
+// Display sink of the frame pipeline (frame_pipeline.h) - runs in the pipeline thread.
+void DisplayImage(GEV_BUFFER_OBJECT *img, void *context)
 {
 	MY_CONTEXT *displayContext = (MY_CONTEXT *)context;
 
-	if (displayContext != NULL)
-	{
-		unsigned long prev_time = 0;
-		//unsigned long cur_time = 0;
-		//unsigned long deltatime = 0;
-		prev_time = us_timer_init();
+	print_buffer_data_info(img);
 
-		// While we are still running.
-		while (!displayContext->exit)
+	// Can the acquired buffer be displayed?
+	if (IsGevPixelTypeX11Displayable(img->format) || displayContext->convertFormat)
+	{
+		// Convert the image format if required.
+		if (displayContext->convertFormat)
 		{
-			GEV_BUFFER_OBJECT *img = NULL;
-			GEV_STATUS status = 0;
-
-			// Wait for images to be received (wait for 1 second here!!)
-			// [R] Actually it waits for 1 sec if buffer is completly empty
-			// And return the pointer to unred frame if buffer has data on it
-			status = GevWaitForNextImage(displayContext->camHandle, &img, 1000);
-
-			if ((img != NULL) && (status == GEVLIB_OK))
-			{
-				print_buffer_data_info(img);
-
-				if (img->status == 0)
-				{
-					m_latestBuffer = img->address;
-
-					// std::cout << "m_latestBuffer is = " << m_latestBuffer << std::endl;
-
-					// Can the acquired buffer be displayed?
-					if (IsGevPixelTypeX11Displayable(img->format) || displayContext->convertFormat)
-					{
-						// Convert the image format if required.
-						if (displayContext->convertFormat)
-						{
-							int gev_depth = GevGetPixelDepthInBits(img->format);
-							// Convert the image to a displayable format.
-							//(Note : Not all formats can be displayed properly at this time (planar, YUV*, 10/12 bit packed).
-							ConvertGevImageToX11Format(img->w, img->h, gev_depth, img->format, img->address,
-													   displayContext->depth, displayContext->format, displayContext->convertBuffer);
-
-							// Display the image in the (supported) converted format.
-							Display_Image(displayContext->View, displayContext->depth, img->w, img->h, displayContext->convertBuffer);
-						}
-						else
-						{
-							// Display the image in the (supported) received format.
-							Display_Image(displayContext->View, img->d, img->w, img->h, img->address);
-						}
-					}
-					else
-					{
-						//printf("Not displayable\n");
-					}
-				}
-				else
-				{
-					// Image had an error (incomplete (timeout/overflow/lost)).
-					// Do any handling of this condition necessary.
-				}
-			}
+			int gev_depth = GevGetPixelDepthInBits(img->format);
+			// Convert the image to a displayable format.
+			//(Note : Not all formats can be displayed properly at this time (planar, YUV*, 10/12 bit packed).
+			ConvertGevImageToX11Format(img->w, img->h, gev_depth, img->format, img->address,
+									   displayContext->depth, displayContext->format, displayContext->convertBuffer);
+
+			// Display the image in the (supported) converted format.
+			Display_Image(displayContext->View, displayContext->depth, img->w, img->h, displayContext->convertBuffer);
+		}
+		else
+		{
+			// Display the image in the (supported) received format.
+			Display_Image(displayContext->View, img->d, img->w, img->h, img->address);
 		}
 	}
-	pthread_exit(0);
+	else
+	{
+		//printf("Not displayable\n");
+	}
 }
 
 int IsTurboDriveAvailable(GEV_CAMERA_HANDLE handle)
@@ -295,12 +262,51 @@ int main(int argc, char *argv[])
 	int camIndex = 0;
 	X_VIEW_HANDLE View = NULL;
 	MY_CONTEXT context = {0};
+	FRAME_PIPELINE pipeline;
 	pthread_t tid;
-	char c;
 	int done = FALSE;
 	int turboDriveAvailable = 0;
 	char uniqueName[128];
 	uint32_t macLow = 0; // Low 32-bits of the mac address (for file naming).
+	const char *batchCommands = NULL;
+	const char *batchScript = NULL;
+	const char *socketPath = NULL;
+	CTL_QUEUE cmdQueue;
+	CTL_SERVER cmdServer = {0};
+	FRAME_RECORDER recorder;
+	FRAME_CODEC codec;
+	int codecReady = FALSE;
+	int compressFrames = FALSE;
+	unsigned long statsTime = 0;
+	unsigned long statsFrames = 0;
+	int opt;
+
+	//============================================================================
+	// Command line options.
+	while ((opt = getopt(argc, argv, "c:f:s:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c':
+			batchCommands = optarg;
+			break;
+		case 'f':
+			batchScript = optarg;
+			break;
+		case 's':
+			socketPath = optarg;
+			break;
+		default:
+			PrintUsage(argv[0]);
+			return (opt == 'h') ? 0 : 1;
+		}
+	}
+
+	CtlQueueInit(&cmdQueue);
+	cmdServer.listen_fd = -1;
+	RecorderInit(&recorder);
+	PipelineInit(&pipeline);
+	pipeline.recorder = &recorder;
 
 	//============================================================================
 	// Greetings
@@ -330,9 +336,9 @@ int main(int argc, char *argv[])
 	// Select the first camera found (unless the command line has a parameter = the camera index)
 	if (numCamera != 0)
 	{
-		if (argc > 1)
+		if (optind < argc)
 		{
-			sscanf(argv[1], "%d", &camIndex);
+			sscanf(argv[optind], "%d", &camIndex);
 			if (camIndex >= (int)numCamera)
 			{
 				printf("Camera index out of range - only %d camera(s) are present\n", numCamera);
@@ -495,20 +501,58 @@ int main(int argc, char *argv[])
 						//===============================================================================================================
 						// Create a thread to receive images from the API and display them.
 						context.View = View;
-						context.camHandle = handle;
-						context.exit = FALSE;
-						pthread_create(&tid, NULL, ImageDisplayThread, &context);
+						pipeline.camHandle = handle;
+						pipeline.display = DisplayImage;
+						pipeline.context = &context;
+						pipeline.exit = FALSE;
+						pthread_create(&tid, NULL, PipelineThread, &pipeline);
 					}
 
 					//===============================================================================================================
-					// // Wait for the Input Key and act accordingly
-					PrintMenu();
+					// Start the command front ends (console / batch / socket) and execute the commands they submit.
+					// (Commands are executed here - the display thread only ever receives frames.)
+					if ((batchCommands != NULL) || (batchScript != NULL))
+					{
+						if (CtlStartBatch(&cmdQueue, batchCommands, batchScript) != 0)
+						{
+							done = TRUE;
+						}
+					}
+					else
+					{
+						PrintMenu();
+						// Without a socket, end of console input ends the program.
+						CtlStartConsole(&cmdQueue, (socketPath == NULL));
+					}
+					if (socketPath != NULL)
+					{
+						if (CtlStartSocketServer(&cmdServer, &cmdQueue, socketPath) == 0)
+						{
+							printf("Listening for commands on %s\n", socketPath);
+						}
+						else
+						{
+							done = TRUE;
+						}
+					}
+
+					statsTime = us_timer_init();
+					statsFrames = 0;
 					while (!done)
 					{
-						c = GetKey();
+						CTL_COMMAND *cmd = CtlWaitCommand(&cmdQueue, 1000);
 
+						if (cmd == NULL)
+						{
+							continue;
+						}
+						cmd->status = 0;
+						cmd->reply[0] = '\0';
+
+						switch (cmd->id)
+						{
 						// Toggle turboMode
-						if ((c == 'T') || (c == 't'))
+						case CTL_CMD_TURBO:
 						{
 							// See if TurboDrive is available.
 							turboDriveAvailable = IsTurboDriveAvailable(handle);
@@ -516,67 +560,83 @@ int main(int argc, char *argv[])
 							{
 								UINT32 val = 1;
 								GevGetFeatureValue(handle, "transferTurboMode", &type, sizeof(UINT32), &val);
-								val = (val == 0) ? 1 : 0;
+								val = (cmd->arg == -1) ? ((val == 0) ? 1 : 0) : (UINT32)cmd->arg;
 								GevSetFeatureValue(handle, "transferTurboMode", sizeof(UINT32), &val);
 								GevGetFeatureValue(handle, "transferTurboMode", &type, sizeof(UINT32), &val);
 								if (val == 1)
 								{
-									printf("TurboMode Enabled\n");
+									snprintf(cmd->reply, sizeof(cmd->reply), "TurboMode Enabled");
 								}
 								else
 								{
-									printf("TurboMode Disabled\n");
+									snprintf(cmd->reply, sizeof(cmd->reply), "TurboMode Disabled");
 								}
 							}
 							else
 							{
-								printf("*** TurboDrive is NOT Available for this device/pixel format combination ***\n");
+								snprintf(cmd->reply, sizeof(cmd->reply), "*** TurboDrive is NOT Available for this device/pixel format combination ***");
+								cmd->status = -1;
 							}
+							break;
 						}
 						// Stop
-						if ((c == 'S') || (c == 's') || (c == '0'))
-						{
+						case CTL_CMD_STOP:
 							GevStopTransfer(handle);
-						}
+							break;
 						//Abort
-						if ((c == 'A') || (c == 'a'))
-						{
+						case CTL_CMD_ABORT:
 							GevAbortTransfer(handle);
-						}
-						// Snap N (1 to 9 frames)
-						if ((c >= '1') && (c <= '9'))
-						{
+							break;
+						// Snap N frames / Continuous grab.
+						case CTL_CMD_SNAP:
+						case CTL_CMD_START:
 							for (i = 0; i < numBuffers; i++)
 							{
 								memset(bufAddress[i], 0, size);
 							}
 
-							status = GevStartTransfer(handle, (UINT32)(c - '0'));
+							status = GevStartTransfer(handle, (cmd->id == CTL_CMD_SNAP) ? (UINT32)cmd->arg : (UINT32)-1);
 							if (status != 0)
-								printf("Error starting grab - 0x%x  or %d\n", status, status);
-						}
-						// Continuous grab.
-						if ((c == 'G') || (c == 'g'))
-						{
-							for (i = 0; i < numBuffers; i++)
 							{
-								memset(bufAddress[i], 0, size);
+								snprintf(cmd->reply, sizeof(cmd->reply), "Error starting grab - 0x%x  or %d", status, status);
+								cmd->status = -1;
 							}
-							status = GevStartTransfer(handle, -1);
-							if (status != 0)
-								printf("Error starting grab - 0x%x  or %d\n", status, status);
-						}
+							break;
 						// Save image
-						if ((c == '@'))
+						case CTL_CMD_SAVE:
 						{
 							char filename[128] = {0};
 							int ret = -1;
 							uint32_t saveFormat = format;
-							void *bufToSave = m_latestBuffer;
+							void *latestBuffer = pipeline.latestBuffer;
+							void *bufToSave = latestBuffer;
 							int allocate_conversion_buffer = 0;
 
 							// Make sure we have data to save.
-							if (m_latestBuffer != NULL)
+							if ((latestBuffer != NULL) && compressFrames)
+							{
+								// Compressed : the sensor data as received (no Bayer conversion), in the recording format.
+								UINT32 convertedFmt = GevGetConvertedPixelType(0, format);
+								UINT32 bytesPerPixel = GetPixelSizeInBytes(convertedFmt);
+								long written;
+
+								_GetUniqueFilename(filename, (sizeof(filename) - 5), uniqueName);
+								strncat(filename, ".gvc", sizeof(filename) - strlen(filename) - 1);
+
+								written = RecorderSaveFrame(filename, &codec, bytesPerPixel, GevIsPixelTypeBayer(convertedFmt), latestBuffer,
+															(size_t)width * height * bytesPerPixel, 0, 0, width, height, convertedFmt);
+								if (written > 0)
+								{
+									snprintf(cmd->reply, sizeof(cmd->reply), "Image saved as : %s : %ld bytes written (%.2f:1)", filename, written,
+											 ((double)width * height * bytesPerPixel) / written);
+								}
+								else
+								{
+									snprintf(cmd->reply, sizeof(cmd->reply), "Error saving image to %s", filename);
+									cmd->status = -1;
+								}
+							}
+							else if (latestBuffer != NULL)
 							{
 								uint32_t component_count = 1;
 								UINT32 convertedFmt = 0;
@@ -608,7 +668,7 @@ int main(int argc, char *argv[])
 									allocate_conversion_buffer = 1;
 
 									// Convert the Bayer to RGB
-									ConvertBayerToRGB(0, height, width, convertedFmt, m_latestBuffer, saveFormat, bufToSave);
+									ConvertBayerToRGB(0, height, width, convertedFmt, latestBuffer, saveFormat, bufToSave);
 								}
 								else
 								{
@@ -627,39 +687,219 @@ int main(int argc, char *argv[])
 								ret = Write_GevImage_ToTIFF(filename, width, height, saveFormat, bufToSave);
 								if (ret > 0)
 								{
-									printf("Image saved as : %s : %d bytes written\n", filename, ret);
+									snprintf(cmd->reply, sizeof(cmd->reply), "Image saved as : %s : %d bytes written", filename, ret);
 								}
 								else
 								{
-									printf("Error %d saving image\n", ret);
+									snprintf(cmd->reply, sizeof(cmd->reply), "Error %d saving image", ret);
+									cmd->status = -1;
 								}
 #else
-								printf("*** Library libtiff not installed ***\n");
+								snprintf(cmd->reply, sizeof(cmd->reply), "*** Library libtiff not installed ***");
+								cmd->status = -1;
 #endif
 							}
 							else
 							{
-								printf("No image buffer has been acquired yet !\n");
+								snprintf(cmd->reply, sizeof(cmd->reply), "No image buffer has been acquired yet !");
+								cmd->status = -1;
 							}
 
 							if (allocate_conversion_buffer)
 							{
 								free(bufToSave);
 							}
+							break;
 						}
-						// Help
-						if (c == '?')
+						// Record frames to a file.
+						case CTL_CMD_RECORD:
+							if (cmd->arg)
+							{
+								char filename[128] = {0};
+								UINT32 convertedFmt = GevGetConvertedPixelType(0, format);
+
+								_GetUniqueFilename(filename, (sizeof(filename) - 5), uniqueName);
+								// (.raw : uncompressed frames, .gvc : compressed - same file layout.)
+								strncat(filename, compressFrames ? ".gvc" : ".raw", sizeof(filename) - strlen(filename) - 1);
+								RecorderSetCodec(&recorder, compressFrames ? &codec : NULL, GetPixelSizeInBytes(convertedFmt),
+												 GevIsPixelTypeBayer(convertedFmt));
+								if (RecorderStart(&recorder, filename, size) == 0)
+								{
+									snprintf(cmd->reply, sizeof(cmd->reply), "Recording to : %s", filename);
+								}
+								else
+								{
+									snprintf(cmd->reply, sizeof(cmd->reply), "Error starting recording (already recording ?)");
+									cmd->status = -1;
+								}
+							}
+							else
+							{
+								RECORD_STATS recStats;
+
+								RecorderStop(&recorder);
+								RecorderGetStats(&recorder, &recStats);
+								snprintf(cmd->reply, sizeof(cmd->reply), "%s : %s : %llu frames (%llu dropped), %llu bytes (%.2f:1)",
+										 recStats.writeError ? "Recording stopped after a write error (file incomplete)" : "Recording stopped",
+										 recorder.filename, (unsigned long long)recStats.framesWritten,
+										 (unsigned long long)recStats.framesDropped, (unsigned long long)recStats.bytesWritten,
+										 recStats.bytesWritten ? ((double)recStats.rawBytes / recStats.bytesWritten) : 1.0);
+								if (recStats.writeError)
+								{
+									cmd->status = -1;
+								}
+							}
+							break;
+						// Lossless compression of recorded / saved frames.
+						case CTL_CMD_COMPRESS:
+							if (cmd->arg && !codecReady)
+							{
+								// Leave a CPU for the receive / display thread.
+								long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+								if (CodecInit(&codec, (numCpus > 1) ? (int)(numCpus - 1) : 1) != 0)
+								{
+									snprintf(cmd->reply, sizeof(cmd->reply), "Error initializing the codec");
+									cmd->status = -1;
+									break;
+								}
+								codecReady = TRUE;
+							}
+							compressFrames = cmd->arg;
+							snprintf(cmd->reply, sizeof(cmd->reply), "Compression %s%s", compressFrames ? "Enabled" : "Disabled",
+									 RecorderIsActive(&recorder) ? " (from the next recording)" : "");
+							break;
+						// Reconfigure a camera feature.
+						case CTL_CMD_SET:
 						{
-							PrintMenu();
+							char oldValue[CTL_MAX_VALUE] = {0};
+							char newValue[CTL_MAX_VALUE] = {0};
+							UINT64 newPayload = 0;
+
+							GevGetFeatureValueAsString(handle, cmd->name, &type, sizeof(oldValue), oldValue);
+							status = GevSetFeatureValueAsString(handle, cmd->name, cmd->value);
+							if (status != 0)
+							{
+								snprintf(cmd->reply, sizeof(cmd->reply), "Error 0x%x setting %s", status, cmd->name);
+								cmd->status = -1;
+								break;
+							}
+
+							// The transfer buffers are allocated once : refuse anything that no longer fits in them.
+							GevGetFeatureValue(handle, "PayloadSize", &type, sizeof(UINT64), &newPayload);
+							if (newPayload > size)
+							{
+								GevSetFeatureValueAsString(handle, cmd->name, oldValue);
+								snprintf(cmd->reply, sizeof(cmd->reply), "%s = %s needs a %llu byte payload (buffers are %llu bytes) - restored %s",
+										 cmd->name, cmd->value, (unsigned long long)newPayload, (unsigned long long)size, oldValue);
+								cmd->status = -1;
+								break;
+							}
+
+							// The display window, the display conversion, 'save' and 'record' are set up for the
+							// startup geometry and pixel format : refuse anything that changes them
+							// (Width / Height / PixelFormat, or indirectly binning, decimation, ...).
+							{
+								UINT32 newWidth = width;
+								UINT32 newHeight = height;
+								UINT32 newFormat = format;
+
+								GevGetFeatureValue(handle, "Width", &type, sizeof(UINT32), &newWidth);
+								GevGetFeatureValue(handle, "Height", &type, sizeof(UINT32), &newHeight);
+								GevGetFeatureValue(handle, "PixelFormat", &type, sizeof(UINT32), &newFormat);
+								if ((newWidth != width) || (newHeight != height) || (newFormat != format))
+								{
+									GevSetFeatureValueAsString(handle, cmd->name, oldValue);
+									snprintf(cmd->reply, sizeof(cmd->reply), "%s = %s changes the image to %ux%u format 0x%08x (running %ux%u format 0x%08x) - restored %s",
+											 cmd->name, cmd->value, newWidth, newHeight, newFormat, width, height, format, oldValue);
+									cmd->status = -1;
+									break;
+								}
+							}
+							GevGetFeatureValueAsString(handle, cmd->name, &type, sizeof(newValue), newValue);
+							snprintf(cmd->reply, sizeof(cmd->reply), "%s = %s (was %s)", cmd->name, newValue, oldValue);
+							break;
 						}
-						// Quit
-						if ((c == 0x1b) || (c == 'q') || (c == 'Q'))
+						case CTL_CMD_GET:
 						{
-							GevStopTransfer(handle);
+							char value[CTL_MAX_VALUE] = {0};
+
+							status = GevGetFeatureValueAsString(handle, cmd->name, &type, sizeof(value), value);
+							if (status == 0)
+							{
+								snprintf(cmd->reply, sizeof(cmd->reply), "%s = %s", cmd->name, value);
+							}
+							else
+							{
+								snprintf(cmd->reply, sizeof(cmd->reply), "Error 0x%x getting %s", status, cmd->name);
+								cmd->status = -1;
+							}
+							break;
+						}
+						// Statistics (the fps is measured since the previous query).
+						case CTL_CMD_STATS:
+						{
+							CTL_LATENCY_STATS cmdStats;
+							RECORD_STATS recStats;
+							CODEC_STATS codecStats = {0};
+							unsigned long now = us_timer_init();
+							unsigned long frames = pipeline.frames;
+							double fps = (now > statsTime) ? ((frames - statsFrames) * 1000000.0 / (now - statsTime)) : 0.0;
+
+							statsTime = now;
+							statsFrames = frames;
+							CtlGetLatencyStats(&cmdQueue, &cmdStats);
+							RecorderGetStats(&recorder, &recStats);
+							if (codecReady)
+							{
+								CodecGetStats(&codec, &codecStats);
+							}
+							snprintf(cmd->reply, sizeof(cmd->reply),
+									 "frames=%lu errors=%lu timeouts=%lu fps=%.2f "
+									 "recording=%d rec_frames=%llu rec_dropped=%llu rec_bytes=%llu rec_raw_bytes=%llu write_error=%d "
+									 "compress=%d codec_frames=%llu codec_ratio=%.2f codec_mb_per_s_core=%.1f "
+									 "cmds=%llu cmd_rtt_avg_us=%llu cmd_rtt_min_us=%llu cmd_rtt_max_us=%llu cmd_wait_max_us=%llu",
+									 frames, pipeline.errors, pipeline.timeouts, fps,
+									 recStats.active, (unsigned long long)recStats.framesWritten,
+									 (unsigned long long)recStats.framesDropped, (unsigned long long)recStats.bytesWritten,
+									 (unsigned long long)recStats.rawBytes, recStats.writeError,
+									 compressFrames, (unsigned long long)codecStats.frames,
+									 codecStats.compressedBytes ? ((double)codecStats.rawBytes / codecStats.compressedBytes) : 0.0,
+									 codecStats.cpuUs ? ((double)codecStats.rawBytes / codecStats.cpuUs) : 0.0,
+									 (unsigned long long)cmdStats.count,
+									 (unsigned long long)(cmdStats.count ? (cmdStats.rtt_sum_us / cmdStats.count) : 0),
+									 (unsigned long long)cmdStats.rtt_min_us, (unsigned long long)cmdStats.rtt_max_us,
+									 (unsigned long long)cmdStats.wait_max_us);
+							break;
+						}
+						// Help
+						case CTL_CMD_HELP:
+							CtlPrintHelp(cmd->reply, sizeof(cmd->reply));
+							break;
+						// Quit
+						case CTL_CMD_QUIT:
 							done = TRUE;
-							context.exit = TRUE;
-							pthread_join(tid, NULL);
+							break;
+						default:
+							break;
 						}
+						CtlComplete(&cmdQueue, cmd);
+					}
+
+					// Release any front end still waiting on a command.
+					CtlQueueShutdown(&cmdQueue);
+					CtlStopSocketServer(&cmdServer);
+
+					GevStopTransfer(handle);
+					RecorderStop(&recorder);
+					if (codecReady)
+					{
+						CodecRelease(&codec);
+					}
+					if (DISPLAY)
+					{
+						pipeline.exit = TRUE;
+						pthread_join(tid, NULL);
 					}
 
 					//===============================================================================================================